@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+constexpr auto MAX_H_RED = 40;
+constexpr auto MIN_H_RED = 0;
+
+// Marker colour range in OpenCV's 8-bit HSV (H in 0 ... 180)
+struct HsvRange
+{
+	int hMin, hMax, sMin, sMax, vMin, vMax;
+};
+const HsvRange MARKER_RANGE = { MIN_H_RED, MAX_H_RED, 160, 255, 80, 255 };
+
+const double THRESHOLD_PERIOD_SECONDS = 3.0; // time between two derivations of the bounds
+const double THRESHOLD_MIN_SAMPLES = 2000; // marker and background pixels needed to move the bounds
+const double THRESHOLD_MAX_MISSED = 0.05; // share of the marker pixels a lower bound may cut off
+const int THRESHOLD_MIN_S = 60; // the lower bounds never go below these
+const int THRESHOLD_MIN_V = 40;
+const int THRESHOLD_HUE_MARGIN = 3;
+const double THRESHOLD_HUE_QUANTILE = 0.01;
+
+// This class keeps the colour range of one camera up to date with the exposure. Pixels at the tracked markers and
+// pixels around them in their windows are counted in hue, saturation and value histograms. Every few seconds the
+// lower saturation and value bounds are moved to where they keep nearly all marker pixels and let the fewest
+// background pixels of marker hue through, and the hue bounds to the spread of the marker pixels,
+// never outside MARKER_RANGE's hue. The histograms then fade by half so old exposures are forgotten.
+// The range is double buffered: Derive writes the unused copy and switches the index, Range can be read from any thread.
+class AdaptiveThreshold
+{
+public:
+	AdaptiveThreshold();
+	void Reset();
+	HsvRange Range() const { return ranges[current.load()]; }
+	void AddMarker(int h, int s, int v)
+	{
+		markerHue[h]++;
+		markerS[s]++;
+		markerV[v]++;
+		markerCount++;
+	}
+	void AddBackground(int h, int s, int v)
+	{
+		// only background of marker hue can pass the threshold
+		if (h < MARKER_RANGE.hMin || h > MARKER_RANGE.hMax)
+		{
+			return;
+		}
+		const HsvRange& now = ranges[current.load(std::memory_order_relaxed)];
+		if (v >= now.vMin)
+		{
+			backgroundS[s]++;
+		}
+		if (s >= now.sMin)
+		{
+			backgroundV[v]++;
+		}
+		backgroundCount++;
+	}
+	bool Derive();
+
+private:
+	static int LowerBound(const double marker[], const double background[], int lowest);
+
+	double markerHue[256], markerS[256], markerV[256];
+	double backgroundS[256], backgroundV[256];
+	double markerCount, backgroundCount;
+	HsvRange ranges[2];
+	std::atomic<int> current;
+	std::chrono::high_resolution_clock::time_point lastDerived;
+};
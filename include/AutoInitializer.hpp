@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Tracker.hpp"
+#include <chrono>
+
+const int AUTOINIT_STABLE_FRAMES = 3; // consecutive frames the constellation must hold still in every camera
+const double AUTOINIT_MAX_MOTION = 8.0; // pixels a marker may move between two frames of a stable constellation
+const double AUTOINIT_BUDGET_SECONDS = 5.0;
+const int AUTOINIT_MIN_AREA = 6; // smaller blobs are noise
+const int AUTOINIT_EXTRA_CANDIDATES = 12; // blobs considered per camera beyond twice the marker count
+
+// This class finds the marker constellation in every camera without any user input.
+// Each frame, the blobs of each camera are found by a full-frame scan and the markers are chosen as the
+// top-to-bottom sequence of blobs with the most regular size and spacing. The cameras are processed in parallel.
+// Initialization succeeds when the chosen constellations stay put for a few frames, and gives up after a time budget.
+class AutoInitializer;
+
+class ConstellationParameters
+{
+public:
+	int camera_index;
+	AutoInitializer* initializerPtr;
+	Tracker* trackerPtr;
+	ConstellationParameters()
+	{
+		camera_index = 0;
+		initializerPtr = NULL;
+		trackerPtr = NULL;
+	}
+};
+
+#if defined (_WIN32)
+DWORD WINAPI FindConstellationThread(LPVOID lpParam);
+#endif
+
+class AutoInitializer
+{
+public:
+	enum Status { Running, Found, TimedOut };
+	AutoInitializer();
+	void Reset();
+	Status Step(Tracker& tracker);
+	const std::vector<cv::Rect>& Candidates(int camera_index) const { return candidates[camera_index]; }
+
+private:
+#if defined (_WIN32)
+	friend DWORD WINAPI FindConstellationThread(LPVOID lpParam);
+#endif
+	void FindConstellation(int camera_index, const cv::Mat& image, int numMarkers);
+
+	BlobScanner scanner[NUM_CAMERAS];
+	std::vector<cv::Point> constellation[NUM_CAMERAS]; // markers of the last frame from top to bottom, empty if not found
+	std::vector<cv::Rect> candidates[NUM_CAMERAS]; // blobs of the last frame that may be markers, with a MARKER_RADIUS margin
+	int stableFrames[NUM_CAMERAS];
+	ConstellationParameters paraList[NUM_CAMERAS];
+	bool started;
+	std::chrono::high_resolution_clock::time_point startTime;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "BitMask.hpp"
+#include "AdaptiveThreshold.hpp"
+
+const int BACKGROUND_STRIPES = 8; // a frame updates every BACKGROUND_STRIPES-th row, so the whole image takes that many frames
+const int BACKGROUND_LEARN_FRAMES = 4 * BACKGROUND_STRIPES; // frames before the model is used
+const int BACKGROUND_MOTION_THRESHOLD = 20; // grey difference to the running median of a moving pixel
+const int BACKGROUND_MOTION_VISITS = 60; // updates a pixel counts as recently moved after it moved
+const int BACKGROUND_STATIC_VISITS = 40; // updates a pixel must stay marker coloured or saturated without moving to be clutter
+const int BACKGROUND_SPECULAR_LEVEL = 250; // grey level of a specular spot
+
+// This class learns the static part of one camera image. Each pixel keeps a running median of its grey level,
+// the number of updates since it last moved, and the number of updates it has stayed marker coloured (or saturated)
+// without moving while tracking. Pixels that stay coloured long enough are static clutter and are left out of the allowed mask,
+// pixels that moved recently are the motion prior of initialization.
+// Only one stripe of rows is updated per frame, so the cost per frame is fixed to 1 / BACKGROUND_STRIPES of an image.
+class BackgroundModel
+{
+public:
+	BackgroundModel();
+	void Reset();
+	void Update(const cv::Mat& image, const BitMask* exclusions, const cv::Rect windows[], int numWindows, bool countStatic, const HsvRange& range);
+	bool Ready() const { return frames >= BACKGROUND_LEARN_FRAMES; }
+	bool SawMotion() const;
+	bool Moved(const cv::Rect& region) const;
+
+	BitMask clutter; // static marker coloured or specular pixels
+	BitMask moved; // pixels that moved in the last BACKGROUND_MOTION_VISITS updates
+	BitMask allowed; // the exclusions of the rig profile without the clutter, what segmentation looks at
+
+private:
+	cv::Mat median, motionVisits, staticVisits;
+	cv::Mat movedRow, clutterRow;
+	int movedPixels[BACKGROUND_STRIPES]; // recently moved pixels of each stripe
+	int frames;
+	int phase;
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+// This function times the specialized kernels against the generic code paths on synthetic frames
+// and prints the results. It is run with --bench instead of tracking, no camera is needed.
+int RunBenchmarks();
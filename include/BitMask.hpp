@@ -0,0 +1,82 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+typedef uint64_t MaskWord;
+const int WORD_BITS = 64;
+
+// index of the lowest set bit, w must not be 0
+inline int CountTrailingZeros(MaskWord w)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, w);
+	return int(index);
+#else
+	return __builtin_ctzll(w);
+#endif
+}
+
+// A connected set of foreground pixels
+struct Blob
+{
+	int area;
+	cv::Rect box;
+	double sumX, sumY;
+	cv::Point2f Centroid() const { return cv::Point2f(float(sumX / area), float(sumY / area)); }
+	cv::Point Center() const { return cv::Point(box.x + box.width / 2, box.y + box.height / 2); }
+};
+
+// This class merges horizontal runs of foreground pixels into 8-connected blobs.
+// Runs are added row by row, from left to right, and are only compared with the runs of the row above.
+class RunLabeler
+{
+public:
+	RunLabeler();
+	void Reset();
+	void BeginRow(int y);
+	void AddRun(int x0, int x1); // pixels x0 <= x < x1 of the current row
+	void Finish(std::vector<Blob>& blobs);
+
+private:
+	int Find(int label);
+	struct Run { int x0, x1, label; };
+	std::vector<Run> runs;
+	std::vector<int> parent;
+	std::vector<Blob> partial; // statistics of every label before labels are joined
+	size_t previousBegin, previousEnd, currentBegin;
+	size_t scan; // first run of the row above that may still touch the current row
+	int row;
+};
+
+// Binary mask stored with one bit per pixel, 64 pixels per word. Bit i of word w is pixel x = 64 * w + i.
+class BitMask
+{
+public:
+	BitMask();
+	void Create(int width, int height);
+	void Clear();
+	void Clear(const cv::Rect& region);
+	void And(const BitMask& other, const cv::Rect& region);
+	void Pack(const cv::Mat& mask, cv::Point at);
+	void Unpack(cv::Mat& mask, const cv::Rect& region) const;
+	bool Get(int x, int y) const { return (words[size_t(y) * wordsPerRow + x / WORD_BITS] >> (x % WORD_BITS)) & 1; }
+	void Close(const cv::Rect& region, int kernelX, int kernelY);
+	void ExtractBlobs(const cv::Rect& region, RunLabeler& labeler, std::vector<Blob>& blobs) const;
+	int Moments(const cv::Rect& region, double& sumX, double& sumY) const;
+	MaskWord* Row(int y) { return &words[size_t(y) * wordsPerRow]; }
+	const MaskWord* Row(int y) const { return &words[size_t(y) * wordsPerRow]; }
+	cv::Size size() const { return cv::Size(width, height); }
+	bool empty() const { return words.empty(); }
+
+	int width, height, wordsPerRow;
+	std::vector<MaskWord> words;
+
+private:
+	std::vector<MaskWord> scratchA, scratchB;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "BitMask.hpp"
+#include "AdaptiveThreshold.hpp"
+
+const int GRID_CELL_SIZE = 64; // pixels, about the size of a detect window
+const int RUN_GAP_FILL = 2; // runs of one row closer than this are joined, a cheap horizontal closing
+
+// Uniform grid over the image holding the centroids of the blobs, for queries around a position
+class BlobGrid
+{
+public:
+	BlobGrid();
+	void Build(const std::vector<Blob>& blobs, cv::Size imageSize);
+	void Within(cv::Point2f position, float maxDistance, std::vector<int>& found) const;
+
+	std::vector<cv::Point2f> centers;
+
+private:
+	int cols, rows;
+	std::vector<int> cellStart; // blobs of cell c are items[cellStart[c]] ... items[cellStart[c + 1] - 1]
+	std::vector<int> items;
+};
+
+// This class scans a whole camera image once per frame. Each row is thresholded into runs,
+// runs are merged into blobs with the rows above, and blob centroids go into a BlobGrid.
+// The cost is one streaming pass over the image whatever the number of markers.
+class BlobScanner
+{
+public:
+	BlobScanner();
+	void Scan(const cv::Mat& image, const BitMask* allowed = NULL);
+
+	std::vector<Blob> blobs;
+	BlobGrid grid;
+	int minArea; // smaller blobs are noise
+	HsvRange range; // colour of the marker pixels, MARKER_RANGE unless the camera's adapted range is set
+
+private:
+	RunLabeler labeler;
+	std::vector<Blob> labeled;
+	cv::Mat hsvRow, rangeRow;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const int C3D_BLOCK = 512; // the file is made of 512 byte blocks
+const float C3D_POINT_SCALE = -0.1f; // negative for floating point data, residuals are stored in steps of 0.1 mm
+const float C3D_DEFAULT_RATE = 200.0f; // frame rate written when the trial is too short to measure it
+const int C3D_MAX_CAMERAS = 7; // cameras the mask of a point can name
+
+struct GaitRecord;
+
+// This class writes a C3D file (www.c3d.org) frame by frame: floating point data, Intel byte order.
+// The markers of every leg are the 3D points, the joint angles are analog channels sampled once per frame.
+// Header and parameters are written by Begin with the trial length and frame rate left open,
+// the frames are appended as they come and End writes header and parameters again with the final values.
+// Only numbers change, so the parameter section keeps its size and is simply overwritten in place.
+// Each point carries the cameras that solved it and its residual; a predicted point has no cameras and residual 0,
+// a point that could not be computed is marked invalid with residual -1.
+class C3DWriter
+{
+public:
+	C3DWriter();
+	bool Begin(std::FILE* file, const std::vector<std::string>& markerNames);
+	size_t FrameSize() const;
+	char* EncodeFrame(const GaitRecord& record, char* out) const;
+	bool End(std::FILE* file, int frames, double firstTime, double lastTime);
+
+private:
+	void BuildHeader(int frames, float rate);
+	void BuildParameters(int frames, float rate);
+	void AddGroup(int id, const char* name, const char* description);
+	void AddParameter(int id, const char* name, int type, const std::vector<int>& dimensions, const void* data, const char* description);
+	void AddStrings(int id, const char* name, const std::vector<std::string>& values, const char* description);
+	bool WriteSections(std::FILE* file);
+
+	int numMarkers;
+	std::vector<std::string> names;
+	std::vector<char> header;
+	std::vector<char> parameters;
+	size_t lastRecord; // start of the last group or parameter, its link to the next one is 0
+	int dataStart; // first block of the frames, counted from 1
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+
+const double BINNING = 2.0; // cameras were calibrated at full resolution, images are 2x2 binned
+
+// Pinhole model of one camera with the lens distortion of its calibration, so projections land on the raw images.
+// Points are given in the frame of the camera pair (the first camera of the pair), in millimetre.
+// Image coordinates are those of the cropped, binned images the tracker works on.
+class CameraModel
+{
+public:
+	CameraModel();
+	~CameraModel();
+	cv::Point2d ToSensor(const cv::Point2d& image) const;
+	cv::Point2d ToImage(const cv::Point2d& sensor) const;
+	cv::Point3d ToCamera(const cv::Point3d& p) const;
+	cv::Point2d Distort(const cv::Point2d& normalized) const;
+	cv::Matx22d DistortJacobian(const cv::Point2d& normalized) const;
+	cv::Point2d Project(const cv::Point3d& p) const;
+	cv::Matx23d ProjectJacobian(const cv::Point3d& p) const;
+	bool InFront(const cv::Point3d& p) const;
+
+	cv::Matx33d K; // intrinsics at full resolution
+	cv::Vec<double, 5> distortion; // k1, k2, p1, p2, k3 of the full resolution sensor coordinates
+	cv::Matx33d R; // pair frame to camera frame
+	cv::Vec3d t;
+	cv::Point2d offset; // position of the cropped image on the sensor
+	double binning;
+	int pair; // index of the camera pair (leg) this camera belongs to
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "RigCalibration.h"
+#include <string>
+#include <vector>
+
+const int MIN_CALIBRATION_VIEWS = 6; // chessboard views a camera, or both cameras of a pair together, need
+
+// This class calibrates the rig from chessboard frames every camera recorded at the same moments.
+// Frame f of camera c is read from cv::format(pattern, c, f), e.g. "calibration/cam%d_%04d.png".
+// The frames are the cropped, binned images the tracker sees; the corners are moved to full resolution sensor
+// coordinates with the offset and binning of the rig, so the solved models fit CameraModel directly.
+class ChessboardCalibration
+{
+public:
+	ChessboardCalibration(const cv::Size& boardSize, double squareSize);
+	int DetectCorners(const std::string& pattern, const RigCalibration& rig);
+	bool Solve(RigCalibration& rig) const;
+	void Verify(const RigCalibration& rig) const;
+
+	cv::Size boardSize; // inner corners per row and per column
+	double squareSize; // millimetre
+	int numFrames;
+	cv::Size sensorSize[NUM_CAMERAS];
+	std::vector<cv::Size> imageSizes[NUM_CAMERAS]; // of each frame, empty where the file did not load
+	std::vector<std::vector<cv::Point2f>> corners[NUM_CAMERAS]; // corners of each frame in sensor coordinates, empty where the board was not found
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+const int COLOUR_LUT_BITS = 5; // bits kept of each channel, the table has 2^15 cells of one byte
+const int COLOUR_LUT_SIZE = 1 << (3 * COLOUR_LUT_BITS);
+const int COLOUR_MIN_SAMPLES = 20; // a marker sampled with fewer pixels gets no class
+const double COLOUR_MAX_DISTANCE = 3.5; // Mahalanobis distance of the farthest colour of a class
+const double COLOUR_MIN_VARIANCE = 16.0; // added to each channel, covers the quantization of the table and the sensor noise
+
+// This class gives every marker its own colour class. The pixels sampled on each marker (Mouse_getColor)
+// are summarized by their mean and covariance in RGB, and all classes are compiled into one lookup table
+// from the quantized RGB colour to the class: 0 is background, marker j is class j + 1.
+// A colour close to several classes goes to the one with the smallest Mahalanobis distance.
+// One table serves all cameras, so each marker should be sampled in every camera window: a class learned
+// in one camera only misses the white balance and lighting of the others.
+class ColourClassifier
+{
+public:
+	ColourClassifier();
+	void Reset();
+	void AddSamples(int marker_index, const cv::Mat& pixels);
+	bool Sampled(int numMarkers) const;
+	bool Compile();
+	bool Ready() const { return compiled; }
+	bool Load(const std::string& path);
+	bool Save(const std::string& path) const;
+	int Classify(const uchar* rgb) const { return lut[Index(rgb[0], rgb[1], rgb[2])]; }
+	static int Index(int r, int g, int b)
+	{
+		const int drop = 8 - COLOUR_LUT_BITS;
+		return ((r >> drop) << (2 * COLOUR_LUT_BITS)) | ((g >> drop) << COLOUR_LUT_BITS) | (b >> drop);
+	}
+
+	int sampleMarker; // the marker the next Mouse_getColor selection belongs to
+	std::vector<uchar> lut;
+
+private:
+	// sums of the samples of one marker, enough to get the mean and covariance
+	struct Statistics
+	{
+		double count;
+		double sum[3];
+		double cross[6]; // rr, rg, rb, gg, gb, bb
+	};
+	std::vector<Statistics> classes;
+	bool compiled;
+};
@@ -1,9 +1,13 @@
+#pragma once
+
 #include "Tracker.hpp"
+#include "CameraModel.h"
+#include "Triangulation.h"
+#include "LensCorrection.h"
+#include "WorldFrameWorker.h"
+#include "GaitExporter.h"
 #include <opencv2/imgproc/types_c.h>
 
-cv::Point3d crossing(cv::Point3d u, cv::Point3d v);
-cv::Point3d scale(cv::Point3d u);
-cv::Point3d operator*(cv::Mat M, cv::Point3d p);
 class DataProcess
 {
 	
@@ -12,19 +16,26 @@ class DataProcess
 public:
 	DataProcess();
 	~DataProcess();
+	bool LoadCalibration(const std::string& path);
 	double second, millisecond, deltat = 0;
-	cv::Point3d thigh[2]; // 0 for left, 1 for right
-	cv::Point3d shank[2];
-	cv::Point3d foot[2];
+	Vec3 thigh[2]; // 0 for left, 1 for right
+	Vec3 shank[2];
+	Vec3 foot[2];
 	int numCameras;
 	//void getTime();
+	void PrepareLens(int camera, const cv::Size& imageSize);
 	void mapTo3D();
 	void getJointAngle();
-	bool exportGaitData();
+	bool exportGaitData(double time);
 	bool FrameTransform();
-	bool DataProcess::FindWorldFrame(cv::Mat,cv::Mat, int);
-	cv::Point points[4][6];
-	cv::Point3d MarkerPos3D[2][6];
+	cv::Point points[NUM_CAMERAS][MAX_MARKERS];
+	cv::Point3d MarkerPos3D[NUM_CAMERAS / 2][MAX_MARKERS];
+	Vec3 MarkerPosWorld[NUM_CAMERAS / 2][MAX_MARKERS]; // MarkerPos3D in the world frame of the pair, in the pair frame until that is known
+	ViewMask usedViews[NUM_CAMERAS / 2][MAX_MARKERS]; // cameras that agreed on each point this frame, 0 if it is predicted
+	double residuals[NUM_CAMERAS / 2][MAX_MARKERS]; // reprojection error of each point, in millimetre at the point
+	ViewMask visibleViews[MAX_MARKERS]; // cameras that detected each marker this frame
+	cv::Point2d sensorPoints[NUM_CAMERAS][MAX_MARKERS]; // points without lens distortion, in full resolution sensor coordinates
+	LensCorrection lens[NUM_CAMERAS];
 
 	cv::Mat image;
 	double time = 0;
@@ -33,12 +44,9 @@ public:
 	double ankle[2];
 	bool GotWorldFrame;
 	bool gettime = false;
-	const double cx = 1124.8;
-	const double cy = 1126.0;
-	const double fx = 1018.7;
-	const double fy = 1002.1;
-	const int T = 200;
-	cv::Point2i offset[4];
-	std::vector<cv::Mat> Rotation;
-	std::vector<cv::Point3d> Transform;
+	CameraModel cameras[NUM_CAMERAS];
+	MultiViewTriangulator triangulation;
+	WorldFrame worldFrame[NUM_CAMERAS / 2]; // latest estimate of the background worker, for each pair
+	GaitExporter exporter;
+	GaitExporter archive; // the session in the column store, when one is given
 };
\ No newline at end of file
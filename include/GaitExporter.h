@@ -0,0 +1,63 @@
+#pragma once
+
+#include "GaitRecord.h"
+#include "C3DWriter.h"
+#include "GaitStore.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+const int GAIT_BLOCK_RECORDS = 256; // records handed to the writer at once, about 1.3 s at 200 fps
+const int GAIT_BLOCKS = 8; // blocks in the pool, the writer may fall this far behind before records are dropped
+
+enum GaitFormat { GaitCsv, GaitC3d, GaitColumns };
+
+// This class writes the gait data of every frame to a CSV file, to a C3D file when the name ends in .c3d
+// or to a session of the column store (GaitStore.h) when it ends in .gaitcol, without slowing the frame loop down.
+// Records are copied into a pool of preallocated blocks, a full block is handed to a background thread
+// that formats it and writes it with one sequential write. The frame loop neither formats nor waits for the disk,
+// if the writer falls GAIT_BLOCKS behind the newest records are dropped and counted.
+class GaitExporter
+{
+public:
+	GaitExporter();
+	~GaitExporter();
+	bool Open(const std::string& path, const std::vector<std::string>& markerNames);
+	bool Append(double time, const Vec3 markers[][MAX_MARKERS], const double residual[][MAX_MARKERS], const ViewMask used[][MAX_MARKERS],
+		const double hip[], const double knee[], const double ankle[]);
+	void Close();
+	bool IsOpen() const { return file != nullptr; }
+
+private:
+	void Run();
+	bool WriteHeader();
+	bool WriteBlock(int block, int count);
+
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool running;
+	long long submitted; // blocks handed to the writer since Open
+	long long written; // blocks the writer is done with
+	int counts[GAIT_BLOCKS]; // records in each submitted block
+
+	// used by the frame loop only
+	std::vector<GaitRecord> records; // GAIT_BLOCKS blocks of GAIT_BLOCK_RECORDS records
+	int filled; // records in the block being filled
+	int frames;
+	long long dropped;
+	int numMarkers;
+
+	// used by the writer, Open and Close create and close the file while no writer runs
+	std::FILE* file;
+	std::vector<std::string> names;
+	std::vector<char> text; // one formatted block
+	GaitFormat format;
+	C3DWriter c3d;
+	GaitStoreWriter store;
+	int recorded; // frames written
+	double firstTime, lastTime;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "RigConstants.h"
+#include "SmallMath.h"
+
+const int GAIT_PAIRS = NUM_CAMERAS / 2;
+
+inline const char* LegName(int pair)
+{
+	return pair == 0 ? "left" : "right";
+}
+
+// One frame of gait data: the world frame marker positions of both legs and the joint angles
+struct GaitRecord
+{
+	double time; // seconds since the start of the session
+	int frame;
+	Vec3 markers[GAIT_PAIRS][MAX_MARKERS];
+	float residual[GAIT_PAIRS][MAX_MARKERS]; // millimetre
+	ViewMask used[GAIT_PAIRS][MAX_MARKERS]; // cameras that solved each point, 0 if it is predicted
+	double hip[GAIT_PAIRS]; // 0 for left, 1 for right
+	double knee[GAIT_PAIRS];
+	double ankle[GAIT_PAIRS];
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+
+const int GAIT_STORE_CHUNK = 1024; // frames of one chunk, about 5 s at 200 fps
+const size_t GAIT_STORE_ALIGN = 4096; // chunks start on page boundaries of the file
+const int GAIT_COLUMN_NAME = 48;
+
+enum GaitColumnType { GaitFloat32 = 1, GaitFloat64 = 2, GaitUInt32 = 3 };
+
+struct GaitRecord;
+
+// Layout of a session file, all values little-endian:
+//   GaitStoreHeader
+//   numColumns x GaitColumnRecord
+//   numChunks chunks from dataOffset on: every column of a chunk is GAIT_STORE_CHUNK values at a fixed stride,
+//     one column after the other, the last chunk is padded to the full size
+//   at indexOffset the summary of each chunk: the minimum of every column, then the maximum of every column, as doubles
+// The header and the summaries are written when the session is closed, a session that was not closed has no chunks.
+struct GaitStoreHeader
+{
+	char magic[8]; // "GAITCOL1"
+	uint32_t version;
+	uint32_t chunkFrames;
+	uint32_t numColumns;
+	uint32_t numChunks;
+	uint64_t numFrames;
+	uint64_t chunkSize; // bytes of one chunk, a multiple of GAIT_STORE_ALIGN
+	uint64_t dataOffset;
+	uint64_t indexOffset;
+};
+
+struct GaitColumnRecord
+{
+	char name[GAIT_COLUMN_NAME];
+	uint32_t type;
+	uint32_t width; // bytes of one value
+	uint64_t offset; // of the column inside a chunk
+};
+
+// This class writes the per-frame outputs of one session as a column store, chunk by chunk.
+// Columns are time, frame, then x, y, z, residual and cameras of every marker of each leg, then the joint angles of each leg,
+// named like the CSV columns of GaitExporter. A chunk is collected in memory and written at once when it is full;
+// only the chunk summaries, 16 bytes per column every GAIT_STORE_CHUNK frames, stay in memory until End.
+class GaitStoreWriter
+{
+public:
+	GaitStoreWriter();
+	bool Begin(std::FILE* file, const std::vector<std::string>& markerNames);
+	bool Add(std::FILE* file, const GaitRecord& record);
+	bool End(std::FILE* file);
+
+private:
+	void AddColumn(const std::string& name, GaitColumnType type);
+	void Store(int column, double value);
+	bool WriteChunk(std::FILE* file);
+
+	int numMarkers;
+	std::vector<GaitColumnRecord> columns;
+	size_t chunkSize;
+	std::vector<char> chunk;
+	int rows; // frames in the chunk
+	std::vector<double> minimum, maximum; // of the chunk being filled
+	std::vector<double> summaries; // of the chunks written
+	uint32_t numChunks;
+	uint64_t numFrames;
+	uint64_t dataOffset;
+};
+
+// A frame whose value lies in the queried range
+struct GaitMatch
+{
+	int session;
+	int frame;
+	double time;
+	double value;
+};
+
+// This class maps a session file written by GaitStoreWriter. Columns are read in place, nothing is parsed or copied.
+class GaitSession
+{
+public:
+	GaitSession();
+	bool Open(const std::string& path);
+	void Close();
+	int Column(const std::string& name) const;
+	double Value(int column, int frame) const;
+	double Time(int frame) const { return Value(0, frame); }
+	int FindFrame(double time) const;
+	int Query(int column, double low, double high, int session, std::vector<GaitMatch>& matches) const;
+
+	std::string path;
+	int numFrames;
+	int numColumns;
+	int numChunks;
+
+private:
+	int ChunkFrames(int chunk) const;
+	const uint8_t* ColumnData(int column, int chunk) const;
+	const double* Minimum(int chunk) const { return summaries + size_t(2 * chunk) * numColumns; }
+	const double* Maximum(int chunk) const { return summaries + size_t(2 * chunk + 1) * numColumns; }
+
+	MappedFile file;
+	const GaitStoreHeader* header;
+	const GaitColumnRecord* columns;
+	const double* summaries;
+};
+
+// This class queries the sessions of a cohort together. A chunk is only read when its summary overlaps the range,
+// so a query touches the summaries of all sessions and the pages of the chunks that can hold a match.
+class GaitCohort
+{
+public:
+	bool Add(const std::string& path);
+	int Query(const std::string& column, double low, double high, std::vector<GaitMatch>& matches) const;
+	int NumChunks() const;
+
+	std::deque<GaitSession> sessions;
+};
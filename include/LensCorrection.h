@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CameraModel.h"
+#include <vector>
+
+const int LENS_GRID_STEP = 8; // image pixels between the nodes of the correction grid
+const int LENS_REFINE_ITERATIONS = 20; // fixed-point steps that bring the nodes to a thousandth of a pixel
+
+// This class removes the lens distortion of one camera from single image points instead of whole images.
+// At start-up the undistorted sensor position of every node of a coarse grid over the image is computed once;
+// a point is then corrected by bilinear interpolation between the four nodes around it, which also adds the crop
+// offset and binning, so the result is what CameraModel::ToSensor gives for a camera without distortion.
+class LensCorrection
+{
+public:
+	LensCorrection();
+	void Build(const CameraModel& camera, const cv::Size& imageSize);
+	void Correct(const cv::Point image[], int count, cv::Point2d sensor[]) const;
+	cv::Point2d Correct(const cv::Point2d& image) const;
+	bool Built() const { return !nodeX.empty(); }
+
+	cv::Size imageSize;
+
+private:
+	int cols, rows; // grid nodes
+	std::vector<double> nodeX, nodeY; // undistorted sensor position of each node, row by row
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// This class maps a whole file read-only into memory, with MapViewOfFile on Windows and mmap elsewhere.
+// data stays valid until Close or destruction.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	bool Open(const std::string& path);
+	void Close();
+
+	const uint8_t* data;
+	size_t size;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+#if defined(_WIN32)
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// A marker and a detection inside the marker's gate. cost is the squared distance
+// divided by the squared gate, so it lies in [0, 1] and leaving a marker unassigned costs 1.
+struct AssignmentEdge
+{
+	int marker;
+	int detection;
+	double cost;
+};
+
+// This class finds the assignment of detections to markers with the least total cost (Hungarian method).
+// Markers and detections are split into the connected components of the gated edges first,
+// each component is solved on its own, so the cost grows with the size of the clusters, not with the marker count.
+class MarkerAssignment
+{
+public:
+	void Solve(int numMarkers, int numDetections, const std::vector<AssignmentEdge>& edges, std::vector<int>& match);
+
+private:
+	int Find(int node);
+	void SolveComponent(const std::vector<int>& markers, const std::vector<int>& detections, const std::vector<AssignmentEdge>& edges, std::vector<int>& match);
+
+	std::vector<int> parent;
+	std::vector<int> componentOf;
+	std::vector<std::vector<int>> componentMarkers, componentDetections, componentEdges;
+	std::vector<int> localIndex;
+	std::vector<double> cost, u, v, minv;
+	std::vector<int> p, way;
+	std::vector<bool> used;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+// This class defines which markers are tracked. It is read at start-up from a file like
+//   %YAML:1.0
+//   markers: [ thigh_upper, thigh_lower, shank_upper, shank_lower, foot_heel, foot_toe ]
+// Markers are numbered in the order of the list. At initialization they are ordered from the top of the image down.
+class MarkerSet
+{
+public:
+	MarkerSet();
+	bool Load(const std::string& path);
+	void UseDefault();
+	int Find(const std::string& name) const;
+	int size() const { return int(names.size()); }
+
+	std::vector<std::string> names;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+// A real numeric array of a MAT file, in MATLAB's column-major order. data points into the mapped file
+// for double arrays; arrays MATLAB stored in a smaller type (it does so for whole numbers) are widened into a copy.
+struct MatArray
+{
+	std::string name;
+	int rows;
+	int cols;
+	const double* data;
+	double at(int row, int col) const { return data[size_t(col) * rows + row]; }
+	size_t size() const { return size_t(rows) * cols; }
+};
+
+// This class maps a MATLAB level 5 MAT file into memory and lists its top-level two-dimensional real arrays.
+// Only uncompressed files are read, i.e. files saved with save(..., '-v6'); compressed variables (the default
+// of save since MATLAB 7) and objects are skipped with a message. The Parameters.mat shipped with the repository
+// is such a compressed stereoParameters object; export the plain arrays from it as described in RigCalibration.h.
+// The arrays stay valid until Close or destruction.
+class MatFile
+{
+public:
+	MatFile();
+	~MatFile();
+	bool Open(const std::string& path);
+	void Close();
+	const MatArray* Find(const std::string& name) const;
+
+	std::vector<MatArray> arrays;
+
+private:
+	MatFile(const MatFile&);
+	MatFile& operator=(const MatFile&);
+	bool ReadMatrix(const uint8_t* element, size_t size);
+
+	MappedFile file;
+	std::deque<std::vector<double>> widened;
+};
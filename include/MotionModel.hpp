@@ -0,0 +1,30 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+const double GATE_SIGMA = 3.0; // search window half size in standard deviations of the innovation
+const int MARKER_RADIUS = 12; // pixels added to the gate so the whole blob stays inside the window
+const int MIN_WINDOW_DIM = 40;
+const int MAX_WINDOW_DIM = 240;
+
+// Constant-acceleration Kalman filter for one marker in one camera image.
+// State is (x, y, vx, vy, ax, ay), in pixels and frames.
+class MarkerKalman
+{
+public:
+	MarkerKalman();
+	~MarkerKalman();
+	void Init(cv::Point2f position);
+	cv::Point2f Predict();
+	void Correct(cv::Point2f measurement);
+	cv::Size WindowSize() const;
+	static cv::Size GateWindow(double sxx, double syy);
+	double GateRadius() const;
+	cv::Rect SearchWindow() const;
+
+	cv::KalmanFilter filter;
+	cv::Point2f prediction;
+	bool initialized;
+	double jerkNoise; // standard deviation of the jerk, pixel/frame^3
+	double measurementNoise; // standard deviation of a centroid, pixel
+};
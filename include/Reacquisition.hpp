@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Tracker.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+const int REACQUIRE_AFTER_FRAMES = 3; // consecutive lost frames before a full frame search is requested
+const int REACQUIRE_DOWNSAMPLE = 4; // full frame search runs on a 1/4 x 1/4 image
+const double REACQUIRE_MIN_SEPARATION = 15.0; // a candidate this close to a tracked marker belongs to it
+const double REACQUIRE_MAX_STEP = 20.0; // pixels a marker moves in the image per frame at most, bounds where a lost marker can be
+
+// This class looks for lost markers in the whole image on a background thread.
+// The frame loop hands over a copy of the frame of every camera that lost a marker and
+// takes the candidates back at the next frame boundary, it never waits for the search.
+class ReacquisitionWorker
+{
+public:
+	ReacquisitionWorker();
+	~ReacquisitionWorker();
+	void Update(Tracker& tracker);
+
+private:
+	void Run();
+	void Search(const cv::Mat& frame, const HsvRange& range, std::vector<cv::Point2f>& candidates);
+	void Merge(Tracker& tracker, int camera_index, const std::vector<cv::Point2f>& candidates);
+
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool running;
+	bool requested[NUM_CAMERAS]; // a frame is waiting for the worker
+	bool ready[NUM_CAMERAS]; // candidates are waiting for the frame loop
+	cv::Mat pending[NUM_CAMERAS];
+	std::vector<cv::Point2f> found[NUM_CAMERAS];
+	std::chrono::high_resolution_clock::time_point lostSince[NUM_CAMERAS][MAX_MARKERS];
+	bool lost[NUM_CAMERAS][MAX_MARKERS];
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "RigConstants.h"
+#include "CameraModel.h"
+#include <string>
+
+// This class holds the calibration of every camera of the rig. It is written by the Calibrate tool and read by the
+// tracker at start-up, stored with cv::FileStorage, e.g.
+//   %YAML:1.0
+//   camera1: { K: !!opencv-matrix ..., distortion: !!opencv-matrix ..., R: !!opencv-matrix ..., t: !!opencv-matrix ...,
+//              offset: [ 500., 300. ], binning: 2., pair: 0 }
+// K and distortion hold at full sensor resolution, R and t map the frame of the first camera of the pair into the camera.
+//
+// A calibration made in MATLAB is read from an uncompressed MAT file holding the arrays cameraN_K, cameraN_distortion,
+// cameraN_R, cameraN_t and optionally cameraN_offset, cameraN_binning, cameraN_pair, e.g. from a stereoParameters s:
+//   camera1_K = s.CameraParameters2.IntrinsicMatrix'; % 1-based principal point as MATLAB gives it, LoadMat moves it to 0-based
+//   camera1_distortion = [s.CameraParameters2.RadialDistortion(1:2), s.CameraParameters2.TangentialDistortion, 0];
+//   camera1_R = s.RotationOfCamera2'; camera1_t = s.TranslationOfCamera2';
+//   save('RigCalibration.mat', '-regexp', '^camera', '-v6');
+class RigCalibration
+{
+public:
+	RigCalibration();
+	void UseDefault();
+	bool Load(const std::string& path);
+	bool LoadMat(const std::string& path);
+	bool Save(const std::string& path) const;
+
+	CameraModel cameras[NUM_CAMERAS];
+	int numCameras;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Size of the rig, shared by the tracker, the calibration tools and the offline readers
+const int NUM_CAMERAS = 4;
+const int MAX_MARKERS = 64; // capacity of the marker arrays, also the most threads WaitForMultipleObjects waits for
+
+typedef uint32_t ViewMask; // bit c stands for camera c, rigs of up to 32 cameras
+
+inline int CountViews(ViewMask views)
+{
+	int count = 0;
+	for (; views; views &= views - 1)
+	{
+		count++;
+	}
+	return count;
+}
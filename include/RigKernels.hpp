@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Tracker.hpp"
+#include <algorithm>
+
+// Layout of the camera images. Images arrive as RGB, the BGR layout is for frames read back from files.
+struct RGB8 { static const int red = 0, green = 1, blue = 2, channels = 3; };
+struct BGR8 { static const int red = 2, green = 1, blue = 0, channels = 3; };
+
+// Fixed-point division tables of cvtColor's 8-bit RGB to HSV conversion, so the colour test
+// done straight on RGB pixels gives exactly the mask cvtColor + inRange would give
+struct HsvTables
+{
+	static const int shift = 12;
+	int sdiv[256];
+	int hdiv[256];
+	HsvTables()
+	{
+		sdiv[0] = hdiv[0] = 0;
+		for (int i = 1; i < 256; i++)
+		{
+			sdiv[i] = cvRound((255 << shift) / double(i));
+			hdiv[i] = cvRound((180 << shift) / (6.0 * i));
+		}
+	}
+	static const HsvTables& Get()
+	{
+		static const HsvTables tables;
+		return tables;
+	}
+};
+
+// This class holds the per-pixel hot loops of the tracker for one image layout.
+// The channel order is a compile-time constant, so the pixel loops index the channels without a branch. Nothing allocates.
+template<class PixelFormat>
+class RigKernels
+{
+public:
+	// This function segments the region of an image into the mask, in one pass without HSV or 8-bit mask buffers.
+	// Pixels that are not set in allowed (when given, same size as the image) stay background.
+	static void Threshold(const cv::Mat& image, const cv::Rect& region, const HsvRange& range, const BitMask* allowed, BitMask& mask)
+	{
+		const HsvTables& tables = HsvTables::Get();
+		for (int y = region.y; y < region.y + region.height; y++)
+		{
+			const uchar* px = image.ptr<uchar>(y) + region.x * PixelFormat::channels;
+			MaskWord* line = mask.Row(y);
+			int x = region.x;
+			const int x1 = region.x + region.width;
+			while (x < x1)
+			{
+				const int wi = x / WORD_BITS;
+				const int bit = x % WORD_BITS;
+				const int count = std::min(WORD_BITS - bit, x1 - x);
+				MaskWord value = 0;
+				for (int k = 0; k < count; k++, px += PixelFormat::channels)
+				{
+					value |= MaskWord(InRange(px, range, tables)) << (bit + k);
+				}
+				if (allowed)
+				{
+					value &= allowed->Row(y)[wi];
+				}
+				MaskWord span = (count == WORD_BITS ? ~MaskWord(0) : ((MaskWord(1) << count) - 1)) << bit;
+				line[wi] = (line[wi] & ~span) | value;
+				x += count;
+			}
+		}
+	}
+
+	// This function labels each pixel of the region with its colour class through the lookup table of a ColourClassifier,
+	// in the same pass the mask gets every pixel of any class. Pixels not set in allowed get class 0.
+	static void Classify(const cv::Mat& image, const cv::Rect& region, const uchar lut[], const BitMask* allowed, cv::Mat& labels, BitMask& mask)
+	{
+		for (int y = region.y; y < region.y + region.height; y++)
+		{
+			const uchar* px = image.ptr<uchar>(y) + region.x * PixelFormat::channels;
+			uchar* label = labels.ptr<uchar>(y);
+			MaskWord* line = mask.Row(y);
+			int x = region.x;
+			const int x1 = region.x + region.width;
+			while (x < x1)
+			{
+				const int wi = x / WORD_BITS;
+				const int bit = x % WORD_BITS;
+				const int count = std::min(WORD_BITS - bit, x1 - x);
+				const MaskWord keep = allowed ? allowed->Row(y)[wi] : ~MaskWord(0);
+				MaskWord value = 0;
+				for (int k = 0; k < count; k++, px += PixelFormat::channels)
+				{
+					uchar c = lut[ColourClassifier::Index(px[PixelFormat::red], px[PixelFormat::green], px[PixelFormat::blue])];
+					c &= uchar(-int((keep >> (bit + k)) & 1));
+					label[x + k] = c;
+					value |= MaskWord(c != 0) << (bit + k);
+				}
+				MaskWord span = (count == WORD_BITS ? ~MaskWord(0) : ((MaskWord(1) << count) - 1)) << bit;
+				line[wi] = (line[wi] & ~span) | value;
+				x += count;
+			}
+		}
+	}
+
+	// This function reproduces cvtColor's 8-bit HSV of one pixel
+	static void Hsv(const uchar* px, const HsvTables& tables, int& h, int& s, int& v)
+	{
+		const int r = px[PixelFormat::red], g = px[PixelFormat::green], b = px[PixelFormat::blue];
+		v = std::max(std::max(r, g), b);
+		const int diff = v - std::min(std::min(r, g), b);
+		const int half = 1 << (HsvTables::shift - 1);
+		s = (diff * tables.sdiv[v] + half) >> HsvTables::shift;
+		h = v == r ? g - b : (v == g ? b - r + 2 * diff : r - g + 4 * diff);
+		h = (h * tables.hdiv[diff] + half) >> HsvTables::shift;
+		if (h < 0)
+		{
+			h += 180;
+		}
+	}
+
+	// This function reproduces cvtColor's 8-bit HSV of one pixel, as far as the range test needs it
+	static bool InRange(const uchar* px, const HsvRange& range, const HsvTables& tables)
+	{
+		const int r = px[PixelFormat::red], g = px[PixelFormat::green], b = px[PixelFormat::blue];
+		const int v = std::max(std::max(r, g), b);
+		if (v < range.vMin || v > range.vMax)
+		{
+			return false;
+		}
+		const int diff = v - std::min(std::min(r, g), b);
+		const int half = 1 << (HsvTables::shift - 1);
+		const int s = (diff * tables.sdiv[v] + half) >> HsvTables::shift;
+		if (s < range.sMin || s > range.sMax)
+		{
+			return false;
+		}
+		int h = v == r ? g - b : (v == g ? b - r + 2 * diff : r - g + 4 * diff);
+		h = (h * tables.hdiv[diff] + half) >> HsvTables::shift;
+		if (h < 0)
+		{
+			h += 180;
+		}
+		return h >= range.hMin && h <= range.hMax;
+	}
+};
+
+// the cameras of the rig deliver RGB8 images
+typedef RigKernels<RGB8> ProductionRigKernels;
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Tracker.hpp"
+
+// This class holds what is known about the rig in the lab and is kept between sessions:
+// rectangles of static red clutter (shoes, mats, fire equipment) each camera must ignore.
+// It is stored with cv::FileStorage, e.g.
+//   %YAML:1.0
+//   camera0: { width: 800, height: 640, exclusions: [ 10, 500, 120, 80,  600, 0, 50, 50 ] }
+// where every four numbers are x, y, width, height of one rectangle in image coordinates.
+class RigProfile
+{
+public:
+	RigProfile();
+	bool Load(const std::string& path);
+	bool Save(const std::string& path) const;
+	void AuthorExclusions(const cv::Mat images[], int numCameras);
+	void BuildMasks(BitMask masks[]) const;
+
+	cv::Size imageSize[NUM_CAMERAS];
+	std::vector<cv::Rect> exclusions[NUM_CAMERAS];
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cmath>
+#include <ostream>
+
+// Fixed-size vectors, matrices and quaternions for the per-marker maths of DataProcess. They live on the stack,
+// nothing allocates, and every operation that fits C++11 constexpr is constexpr, so constant frames fold at compile time.
+// The members are plain doubles, so loops over the marker arrays vectorize. Matrices are row-major.
+
+struct Vec3
+{
+	double x, y, z;
+	constexpr Vec3() :x(0), y(0), z(0) {}
+	constexpr Vec3(double x_, double y_, double z_) :x(x_), y(y_), z(z_) {}
+};
+
+constexpr Vec3 operator+(const Vec3& a, const Vec3& b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+constexpr Vec3 operator-(const Vec3& a, const Vec3& b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+constexpr Vec3 operator-(const Vec3& a) { return Vec3(-a.x, -a.y, -a.z); }
+constexpr Vec3 operator*(const Vec3& a, double s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+constexpr Vec3 operator*(double s, const Vec3& a) { return Vec3(a.x * s, a.y * s, a.z * s); }
+constexpr double Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+constexpr Vec3 Cross(const Vec3& a, const Vec3& b) { return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+constexpr double Component(const Vec3& a, int k) { return k == 0 ? a.x : (k == 1 ? a.y : a.z); }
+inline double Norm(const Vec3& a) { return std::sqrt(Dot(a, a)); }
+inline Vec3 Normalized(const Vec3& a) { return a * (1.0 / Norm(a)); }
+
+// 3x3 matrix, the identity by default
+struct Mat33
+{
+	Vec3 row[3];
+	constexpr Mat33() :row{ Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1) } {}
+	constexpr Mat33(const Vec3& r0, const Vec3& r1, const Vec3& r2) :row{ r0, r1, r2 } {}
+	constexpr Vec3 Column(int k) const { return Vec3(Component(row[0], k), Component(row[1], k), Component(row[2], k)); }
+	constexpr Mat33 Transposed() const { return Mat33(Column(0), Column(1), Column(2)); }
+};
+
+constexpr Vec3 operator*(const Mat33& m, const Vec3& v) { return Vec3(Dot(m.row[0], v), Dot(m.row[1], v), Dot(m.row[2], v)); }
+constexpr Mat33 MultiplyTransposed(const Mat33& a, const Mat33& bt) { return Mat33(bt * a.row[0], bt * a.row[1], bt * a.row[2]); }
+constexpr Mat33 operator*(const Mat33& a, const Mat33& b) { return MultiplyTransposed(a, b.Transposed()); }
+
+// 3x4 affine transform [linear | translation], applied as linear * p + translation
+struct Mat34
+{
+	Mat33 linear;
+	Vec3 translation;
+	constexpr Mat34() :linear(), translation() {}
+	constexpr Mat34(const Mat33& linear_, const Vec3& translation_) :linear(linear_), translation(translation_) {}
+};
+
+constexpr Vec3 operator*(const Mat34& m, const Vec3& p) { return m.linear * p + m.translation; }
+constexpr Mat34 operator*(const Mat34& a, const Mat34& b) { return Mat34(a.linear * b.linear, a.linear * b.translation + a.translation); }
+
+// 4x4 homogeneous matrix, the identity by default
+struct Mat44
+{
+	double m[4][4];
+	constexpr Mat44() :m{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } {}
+	constexpr Mat44(const Mat34& a) :m{ { a.linear.row[0].x, a.linear.row[0].y, a.linear.row[0].z, a.translation.x },
+		{ a.linear.row[1].x, a.linear.row[1].y, a.linear.row[1].z, a.translation.y },
+		{ a.linear.row[2].x, a.linear.row[2].y, a.linear.row[2].z, a.translation.z }, { 0, 0, 0, 1 } } {}
+};
+
+// the point p with w = 1 through the matrix, divided by the resulting w
+constexpr Vec3 operator*(const Mat44& a, const Vec3& p)
+{
+	return Vec3(a.m[0][0] * p.x + a.m[0][1] * p.y + a.m[0][2] * p.z + a.m[0][3],
+		a.m[1][0] * p.x + a.m[1][1] * p.y + a.m[1][2] * p.z + a.m[1][3],
+		a.m[2][0] * p.x + a.m[2][1] * p.y + a.m[2][2] * p.z + a.m[2][3])
+		* (1.0 / (a.m[3][0] * p.x + a.m[3][1] * p.y + a.m[3][2] * p.z + a.m[3][3]));
+}
+
+inline Mat44 operator*(const Mat44& a, const Mat44& b)
+{
+	Mat44 c;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			c.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+		}
+	}
+	return c;
+}
+
+// rotation quaternion w + xi + yj + zk, the identity by default
+struct Quat
+{
+	double w, x, y, z;
+	constexpr Quat() :w(1), x(0), y(0), z(0) {}
+	constexpr Quat(double w_, double x_, double y_, double z_) :w(w_), x(x_), y(y_), z(z_) {}
+	constexpr Vec3 Axis() const { return Vec3(x, y, z); }
+};
+
+constexpr Quat operator*(const Quat& a, const Quat& b)
+{
+	return Quat(a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z, a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x, a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w);
+}
+constexpr Quat Conjugate(const Quat& q) { return Quat(q.w, -q.x, -q.y, -q.z); }
+
+// v rotated by the unit quaternion q, v + 2w (u x v) + 2 u x (u x v)
+constexpr Vec3 Rotate(const Quat& q, const Vec3& v)
+{
+	return v + Cross(q.Axis(), v) * (2 * q.w) + Cross(q.Axis(), Cross(q.Axis(), v)) * 2.0;
+}
+
+constexpr Mat33 ToMatrix(const Quat& q)
+{
+	return Mat33(Vec3(1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y - q.w * q.z), 2 * (q.x * q.z + q.w * q.y)),
+		Vec3(2 * (q.x * q.y + q.w * q.z), 1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z - q.w * q.x)),
+		Vec3(2 * (q.x * q.z - q.w * q.y), 2 * (q.y * q.z + q.w * q.x), 1 - 2 * (q.x * q.x + q.y * q.y)));
+}
+
+inline Quat Normalized(const Quat& q)
+{
+	const double s = 1.0 / std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+	return Quat(q.w * s, q.x * s, q.y * s, q.z * s);
+}
+
+// This function converts a rotation matrix, starting from the largest of w, x, y, z so the division stays stable
+inline Quat FromMatrix(const Mat33& r)
+{
+	const double m00 = r.row[0].x, m11 = r.row[1].y, m22 = r.row[2].z, trace = m00 + m11 + m22;
+	if (trace > 0)
+	{
+		const double s = 2 * std::sqrt(1 + trace);
+		return Normalized(Quat(s / 4, (r.row[2].y - r.row[1].z) / s, (r.row[0].z - r.row[2].x) / s, (r.row[1].x - r.row[0].y) / s));
+	}
+	if (m00 > m11 && m00 > m22)
+	{
+		const double s = 2 * std::sqrt(1 + m00 - m11 - m22);
+		return Normalized(Quat((r.row[2].y - r.row[1].z) / s, s / 4, (r.row[0].y + r.row[1].x) / s, (r.row[0].z + r.row[2].x) / s));
+	}
+	if (m11 > m22)
+	{
+		const double s = 2 * std::sqrt(1 + m11 - m00 - m22);
+		return Normalized(Quat((r.row[0].z - r.row[2].x) / s, (r.row[0].y + r.row[1].x) / s, s / 4, (r.row[1].z + r.row[2].y) / s));
+	}
+	const double s = 2 * std::sqrt(1 + m22 - m00 - m11);
+	return Normalized(Quat((r.row[1].x - r.row[0].y) / s, (r.row[0].z + r.row[2].x) / s, (r.row[1].z + r.row[2].y) / s, s / 4));
+}
+
+inline std::ostream& operator<<(std::ostream& out, const Vec3& v)
+{
+	return out << "[" << v.x << ", " << v.y << ", " << v.z << "]";
+}
+
+inline std::ostream& operator<<(std::ostream& out, const Mat33& m)
+{
+	return out << m.row[0] << "\n" << m.row[1] << "\n" << m.row[2];
+}
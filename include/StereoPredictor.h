@@ -0,0 +1,38 @@
+#pragma once
+#include "DataProcess.h"
+
+// Constant-velocity Kalman filter of one marker in the pair frame, state is (X, Y, Z, VX, VY, VZ).
+// It is corrected with the triangulated point when both views see the marker,
+// or with the single view that still sees it (extended Kalman update).
+class MarkerKalman3D
+{
+public:
+	MarkerKalman3D();
+	void Init(const cv::Point3d& position);
+	void Predict();
+	void Correct(const cv::Point3d& position);
+	void CorrectView(const CameraModel& camera, const cv::Point2d& observation);
+	cv::Point3d Position() const;
+	cv::Matx33d PositionCov() const;
+
+	cv::Vec6d x;
+	cv::Matx66d P;
+	bool initialized;
+	double accelerationNoise; // mm/frame^2
+	double pointNoise; // triangulation noise, mm
+	double pixelNoise; // centroid noise, pixel
+};
+
+// This class predicts every marker on its 3D trajectory and places the detect windows of all cameras
+// that see it, so both views of a pair agree and a view that lost the marker gets it back from the other one.
+class StereoPredictor
+{
+public:
+	StereoPredictor();
+	~StereoPredictor();
+	void Update(const DataProcess& dataProcess);
+	void GuideTracker(const DataProcess& dataProcess);
+	void Reset();
+
+	MarkerKalman3D filter[NUM_CAMERAS / 2][MAX_MARKERS];
+};
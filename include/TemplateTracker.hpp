@@ -0,0 +1,33 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc/types_c.h>
+#include <vector>
+#include "MotionModel.hpp"
+
+const int TEMPLATE_DIM = 2 * MARKER_RADIUS + 1; // grayscale patch around the marker centre
+const int TEMPLATE_REFRESH_FRAMES = 5; // frames between two refreshes of the patch from a colour detection
+const double TEMPLATE_MIN_SCORE = 0.8; // normalized cross-correlation needed to accept a match
+const int TEMPLATE_SEARCH_RADIUS = 2 * MARKER_RADIUS; // the patch centre is searched this far from the prediction
+
+// This class keeps a small grayscale patch of one marker in one camera, taken from the last colour detections.
+// When the colour blob of the marker vanishes (specular highlight, lighting change) the patch is searched
+// by normalized cross-correlation near the prediction instead. The colour blob is only gone for a few frames,
+// so the marker is close to its prediction even when the detect window has grown.
+class MarkerTemplate
+{
+public:
+	MarkerTemplate();
+	void Refresh(const cv::Mat& image, cv::Point position);
+	bool Search(const cv::Mat& image, const cv::Rect& window, cv::Point2f predicted, cv::Point& position, double& score);
+
+	bool valid;
+	bool usedThisFrame; // the marker was found by the patch, it must not refresh itself from that
+	int age; // frames since the last refresh
+
+private:
+	cv::Mat patch; // zero mean, CV_32F
+	double patchNorm;
+	cv::Mat gray, grayFloat, sum, sqsum; // search scratch of the window
+	std::vector<float> response; // cross term of one row of positions
+};
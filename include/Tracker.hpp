@@ -8,13 +8,21 @@
 #include<vector>
 #include <Windows.h>
 #include<cmath>
+#include "RigConstants.h"
+#include "MotionModel.hpp"
+#include "BitMask.hpp"
+#include "BlobScanner.hpp"
+#include "MarkerSet.hpp"
+#include "MarkerAssignment.hpp"
+#include "TemplateTracker.hpp"
+#include "BackgroundModel.hpp"
+#include "ColourClassifier.hpp"
+#include "AdaptiveThreshold.hpp"
 
-constexpr auto MAX_H_RED = 40;
-constexpr auto MIN_H_RED = 0;
-const int NUM_CAMERAS = 4;
-const int NUM_MARKERS = 6;
-const double weight = 0.65;
-enum TrackerType { ByDetection, CV_KCF, ByColor };
+const int MEANSHIFT_ITERATIONS = 5;
+const int MEANSHIFT_MARGIN = 4; // pixels around the kernel that must be free of marker pixels
+const double MEANSHIFT_MIN_CONFIDENCE = 0.9; // share of the pixels near the kernel that lie inside it, below this ByColor falls back to detection
+enum TrackerType { ByDetection, CV_KCF, ByColor, ByBlobScan };
 
 class Tracker
 {
@@ -22,7 +30,7 @@ class Tracker
 public:
 	Tracker();
 	~Tracker();
-	void ColorThresholding(int);
+	void ColorThresholding(int camera_index, const cv::Rect& region);
 	void ColorThresholding();
 	static int CorlorsChosen[3];
 
@@ -33,25 +41,70 @@ public:
 	static cv::Rect calibration_region;
 	bool getContoursAndMoment(int camera_index);
 	bool getContoursAndMoment(int camera_index, int marker_index);
+	cv::Point2f ExpectedCenter(int camera_index, int marker_index) const;
+	bool MeanShift(int camera_index, int marker_index);
+	bool TemplateSearch(int camera_index, int marker_index);
 	//void patternMatch();
 	
 	static cv::Mat image;
 	static bool getColors;
     static cv::Mat ReceivedImages[NUM_CAMERAS]; // Left_Upper, Right_Upper, Right_Lower, Left_Lower
-	cv::Mat detectWindow;
 	cv::Mat detectWindow_Initial;
 	cv::Point detectPosition;
 	cv::Point detectPosition_Initial;
-	static cv::Point currentPos[NUM_CAMERAS][NUM_MARKERS]; // first entry is the index of image, second entry is the index of marker
-	static cv::Point previousPos[NUM_CAMERAS][NUM_MARKERS];// make it static to share between multiple tracker object
-	cv::Point momentum[NUM_CAMERAS]; // 动量：即前两帧的位置差
+	static cv::Point currentPos[NUM_CAMERAS][MAX_MARKERS]; // first entry is the index of image, second entry is the index of marker
+	static cv::Point previousPos[NUM_CAMERAS][MAX_MARKERS];// make it static to share between multiple tracker object
+	static MarkerKalman motionModel[NUM_CAMERAS][MAX_MARKERS]; // 每个marker在每个相机中的运动模型
+	static cv::Rect searchWindow[NUM_CAMERAS][MAX_MARKERS]; // detect window used in the last update
+	static int lostFrames[NUM_CAMERAS][MAX_MARKERS]; // number of consecutive frames without detection
+	static cv::Rect lastSeenWindow[NUM_CAMERAS][MAX_MARKERS]; // detect window of the last frame the marker was found in
+	static bool guided[NUM_CAMERAS][MAX_MARKERS]; // the window comes from the 3D prediction of the stereo pair
+	static cv::Rect guidedWindow[NUM_CAMERAS][MAX_MARKERS];
+	static cv::Point2f guidedCenter[NUM_CAMERAS][MAX_MARKERS];
+	static BitMask segmentedMask[NUM_CAMERAS]; // colour mask of each camera, 1 bit per pixel, valid inside segmentedRegions
+	static std::vector<cv::Rect> segmentedRegions[NUM_CAMERAS]; // disjoint rectangles covering all detect windows
+	static BlobScanner scanner[NUM_CAMERAS]; // whole image blobs for ByBlobScan
+	static std::vector<cv::Point> candidates[NUM_CAMERAS][MAX_MARKERS]; // blobs found in the window of each marker, before assignment
+	static MarkerAssignment assignment[NUM_CAMERAS];
+	static MarkerTemplate templates[NUM_CAMERAS][MAX_MARKERS]; // grayscale patches for frames where the colour blob vanished
+	static MarkerSet markerSet;
+	static int numMarkers; // markers of markerSet, the arrays hold up to MAX_MARKERS
+	static cv::Mat hsvBuffer[NUM_CAMERAS];
+	static cv::Mat rangeBuffer[NUM_CAMERAS];
+	static BitMask allowedMask[NUM_CAMERAS]; // pixels outside the static exclusions of the rig profile, empty if there are none
+	static BackgroundModel background[NUM_CAMERAS]; // static clutter and recent motion of each camera
+	static ColourClassifier colourClasses; // one colour per marker, sampled with Mouse_getColor
+	static cv::Mat classLabels[NUM_CAMERAS]; // colour class of each pixel inside segmentedRegions, when identity comes from colour
+	static AdaptiveThreshold thresholds[NUM_CAMERAS]; // colour range of each camera, follows the exposure
+	RunLabeler labeler; // blob extraction scratch of the thread that owns this tracker
+	std::vector<Blob> blobs;
+	BitMask classMask; // pixels of one marker's colour class in its window
+	std::vector<cv::Rect> backgroundWindows; // regions UpdateBackground keeps out of the clutter
+	cv::Mat classScratch;
 	
 	//int cmin = 80; // minimum and maximum value for contours
 	//int cmax = 140;
 	bool InitTracker(TrackerType);
-	bool FilterInitialImage();
+	bool FilterInitialImage(int camera_index);
 	bool RectifyMarkerPos(int);
-	int detectWindowDimX; // the dimension of detectWindow_Initial
+	static bool LoadMarkerSet(const std::string& path);
+	static const BitMask* AllowedMask(int camera_index);
+	void UpdateBackground(int camera_index, const std::vector<cv::Rect>& candidates);
+	static bool ColourIdentity(int camera_index);
+	void BuildMarkerMask(int camera_index, int marker_index);
+	const BitMask& MarkerMask(int camera_index) const;
+	bool IdentifyByColour(int camera_index);
+	void SampleColours(int camera_index, const std::vector<int>& match);
+	void InitMotionModels();
+	cv::Rect PredictSearchWindow(int camera_index, int marker_index);
+	void PredictSearchWindows();
+	static void MergeWindows(const std::vector<cv::Rect>& windows, std::vector<cv::Rect>& regions);
+	void SegmentCamera(int camera_index);
+	void ScanCamera(int camera_index);
+	void AssignDetections(int camera_index, const std::vector<cv::Point2f>& detections, const BlobGrid* grid, const std::vector<int>* owner, std::vector<int>& match);
+	void AssignMarkers(int camera_index);
+	void UpdateMotionModel(int camera_index, int marker_index, bool found);
+	int detectWindowDimX; // the dimension of the detect window before the motion model is initialized
 	int detectWindowDimY;
 	int numCameras;
 	int threshold;
@@ -75,7 +128,25 @@ public:
 	}
 };
 
+class SegmentationParameters
+{
+public:
+	int camera_index;
+	Tracker* trackerPtr;
+	SegmentationParameters()
+	{
+		camera_index = 0;
+		trackerPtr = NULL;
+	}
+	~SegmentationParameters()
+	{
+
+	}
+};
+
 #if defined (_WIN32)
 DWORD WINAPI UpdateTracker(LPVOID lpParam);
+DWORD WINAPI UpdateSegmentation(LPVOID lpParam);
+DWORD WINAPI UpdateBlobScan(LPVOID lpParam);
 #endif
 
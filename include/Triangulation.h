@@ -0,0 +1,51 @@
+#pragma once
+
+#include "RigConstants.h"
+#include "BitMask.hpp"
+#include "CameraModel.h"
+#include <vector>
+
+const double MULTIVIEW_MAX_RESIDUAL = 6.0; // sensor pixels, a view farther from the solved point is an outlier
+const int MULTIVIEW_REFINE_ITERATIONS = 2;
+
+// Observations of a batch of points stored as structure of arrays, one set of arrays per camera, so thousands of frames
+// of a recording are a few contiguous blocks. Coordinates are undistorted sensor pixels at full resolution, the weight
+// of a view is 1 / its variance. Point k is seen by the cameras of views[k], the entries of the other cameras are unused.
+struct ObservationBatch
+{
+	std::vector<ViewMask> views;
+	std::vector<double> x[NUM_CAMERAS], y[NUM_CAMERAS], weight[NUM_CAMERAS];
+	void Clear();
+	void Reserve(size_t count);
+	void Add(ViewMask pointViews, const cv::Point2d sensor[], const double pointWeight[]);
+	size_t size() const { return views.size(); }
+};
+
+// Points of a batch in the frame of their group, the cameras that agreed on each and its RMS reprojection error in sensor pixels
+struct BatchPoints
+{
+	std::vector<double> x, y, z, residual;
+	std::vector<ViewMask> inliers;
+	void Resize(size_t count);
+	cv::Point3d Point(size_t k) const { return cv::Point3d(x[k], y[k], z[k]); }
+};
+
+// This class triangulates a marker from any set of cameras that see it this frame. Cameras are grouped by the leg they
+// look at (CameraModel::pair), a group may hold two or more cameras. The point is the weighted linear least-squares
+// solution over the views refined on the reprojection error; while the worst view lies farther than
+// MULTIVIEW_MAX_RESIDUAL from it and more than two views remain, that view is dropped and the point solved again.
+class MultiViewTriangulator
+{
+public:
+	MultiViewTriangulator();
+	void SetCameras(const CameraModel cameras[], int numCameras);
+	bool Solve(const cv::Point2d sensor[], const double weight[], ViewMask views, cv::Point3d& point, ViewMask& inliers, double& residual) const;
+	void TriangulateFrame(const CameraModel cameras[], const cv::Point2d sensor[][MAX_MARKERS], const ViewMask visible[], int numMarkers,
+		cv::Point3d out[][MAX_MARKERS], ViewMask used[][MAX_MARKERS], double residual[][MAX_MARKERS]) const;
+	int TriangulateBatch(const ObservationBatch& batch, BatchPoints& points) const;
+
+	int numCameras;
+	int numGroups;
+	ViewMask groupViews[NUM_CAMERAS]; // the cameras of each group
+	cv::Matx34d projection[NUM_CAMERAS];
+};
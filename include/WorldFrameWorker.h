@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Tracker.hpp"
+#include "CameraModel.h"
+#include "Triangulation.h"
+#include "LensCorrection.h"
+#include "SmallMath.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+const int WORLD_FRAME_DOWNSAMPLE = 2; // the board is found on a 1/2 x 1/2 grey image
+const int WORLD_FRAME_VIEWS = 10; // board views of a pair averaged before its world frame is final
+const int WORLD_FRAME_WINDOW = 7; // half size of the full resolution window each corner is refined in
+const int WORLD_BOARD_COLUMNS = 3, WORLD_BOARD_ROWS = 3; // inner corners of the board on the floor
+
+// Pose of the world frame seen by one camera pair: world = rotation * (point + transform) for a point of the pair frame.
+// The sagittal plane of the world frame is x-z, the frontal plane y-z.
+struct WorldFrame
+{
+	WorldFrame() :views(0) {}
+	Mat34 ToWorld() const { return Mat34(rotation, rotation * transform); }
+	Mat33 rotation;
+	Vec3 transform;
+	int views; // board views averaged so far, 0 while the pair has not seen the board
+};
+
+inline Vec3 ToVec3(const cv::Point3d& p)
+{
+	return Vec3(p.x, p.y, p.z);
+}
+
+// This class estimates the world frame of every camera pair from the board on a background thread.
+// The frame loop hands over copies of the frames and takes the latest estimate back at the next frame boundary,
+// it never waits for the detection. The estimate of a pair is refined with every view until WORLD_FRAME_VIEWS are averaged.
+class WorldFrameWorker
+{
+public:
+	WorldFrameWorker(const CameraModel cameras[], int numCameras);
+	~WorldFrameWorker();
+	bool Update(const cv::Mat images[], WorldFrame frames[]);
+
+private:
+	void Run();
+	bool Detect(const cv::Mat& image, std::vector<cv::Point2d>& corners) const;
+	bool AddView(int group, const std::vector<cv::Point2d> corners[], ViewMask views);
+
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool running;
+	bool requested; // frames are waiting for the worker
+	bool ready; // an estimate is waiting for the frame loop
+	bool converged;
+	cv::Mat pending[NUM_CAMERAS];
+	WorldFrame published[NUM_CAMERAS / 2];
+
+	// used by the worker only
+	int numCameras;
+	CameraModel cameras[NUM_CAMERAS];
+	MultiViewTriangulator triangulation;
+	LensCorrection lens[NUM_CAMERAS];
+	Vec3 cornerSum[NUM_CAMERAS / 2][3];
+	WorldFrame estimate[NUM_CAMERAS / 2];
+};
@@ -0,0 +1,106 @@
+// 根据marker和背景像素的直方图，随曝光变化自动调整每个相机的颜色阈值
+#include "AdaptiveThreshold.hpp"
+#include <algorithm>
+#include <iostream>
+
+
+AdaptiveThreshold::AdaptiveThreshold()
+{
+	Reset();
+}
+
+void AdaptiveThreshold::Reset()
+{
+	std::fill(markerHue, markerHue + 256, 0.0);
+	std::fill(markerS, markerS + 256, 0.0);
+	std::fill(markerV, markerV + 256, 0.0);
+	std::fill(backgroundS, backgroundS + 256, 0.0);
+	std::fill(backgroundV, backgroundV + 256, 0.0);
+	markerCount = backgroundCount = 0;
+	ranges[0] = ranges[1] = MARKER_RANGE;
+	current.store(0);
+	lastDerived = std::chrono::high_resolution_clock::now();
+}
+
+// This function picks the lower bound: of the bounds that keep all but THRESHOLD_MAX_MISSED of the marker pixels,
+// the lowest one that lets the fewest background pixels through
+int AdaptiveThreshold::LowerBound(const double marker[], const double background[], int lowest)
+{
+	double markerTotal = 0, backgroundTotal = 0;
+	for (int x = 0; x < 256; x++)
+	{
+		markerTotal += marker[x];
+		backgroundTotal += background[x];
+	}
+	double missed = 0, passed = backgroundTotal;
+	for (int x = 0; x < lowest; x++)
+	{
+		missed += marker[x];
+		passed -= background[x];
+	}
+	int best = lowest;
+	double bestPassed = passed;
+	for (int t = lowest; t < 256 && missed <= THRESHOLD_MAX_MISSED * markerTotal; t++)
+	{
+		if (passed < bestPassed)
+		{
+			best = t;
+			bestPassed = passed;
+		}
+		missed += marker[t];
+		passed -= background[t];
+	}
+	return best;
+}
+
+// This function derives a new range when the period is over and enough pixels were counted, returns whether it did
+bool AdaptiveThreshold::Derive()
+{
+	auto now = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsed = now - lastDerived;
+	if (elapsed.count() < THRESHOLD_PERIOD_SECONDS)
+	{
+		return false;
+	}
+	lastDerived = now;
+	if (markerCount < THRESHOLD_MIN_SAMPLES || backgroundCount < THRESHOLD_MIN_SAMPLES)
+	{
+		return false;
+	}
+	const int active = current.load();
+	HsvRange next = ranges[active];
+	next.sMin = LowerBound(markerS, backgroundS, THRESHOLD_MIN_S);
+	next.vMin = LowerBound(markerV, backgroundV, THRESHOLD_MIN_V);
+	// hue from the quantiles of the marker pixels
+	double below = 0;
+	int low = 0, high = 255;
+	for (int h = 0; h < 256; h++)
+	{
+		below += markerHue[h];
+		if (below <= THRESHOLD_HUE_QUANTILE * markerCount)
+		{
+			low = h + 1;
+		}
+		if (below < (1 - THRESHOLD_HUE_QUANTILE) * markerCount)
+		{
+			high = h + 1;
+		}
+	}
+	next.hMin = std::max(MARKER_RANGE.hMin, std::min(low - THRESHOLD_HUE_MARGIN, MARKER_RANGE.hMax));
+	next.hMax = std::min(MARKER_RANGE.hMax, std::max(high + THRESHOLD_HUE_MARGIN, next.hMin));
+	ranges[1 - active] = next;
+	current.store(1 - active);
+
+	for (int x = 0; x < 256; x++)
+	{
+		markerHue[x] *= 0.5;
+		markerS[x] *= 0.5;
+		markerV[x] *= 0.5;
+		backgroundS[x] *= 0.5;
+		backgroundV[x] *= 0.5;
+	}
+	markerCount *= 0.5;
+	backgroundCount *= 0.5;
+	std::cout << "Colour range H " << next.hMin << "-" << next.hMax << " S " << next.sMin << " V " << next.vMin << std::endl;
+	return true;
+}
@@ -0,0 +1,206 @@
+// 无需鼠标交互的自动初始化：根据几何关系（竖直顺序、间距、大小）在每个相机中找到marker
+#include "AutoInitializer.hpp"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+
+AutoInitializer::AutoInitializer()
+{
+	Reset();
+}
+
+void AutoInitializer::Reset()
+{
+	started = false;
+	for (int i = 0; i < NUM_CAMERAS; i++)
+	{
+		constellation[i].clear();
+		candidates[i].clear();
+		stableFrames[i] = 0;
+	}
+}
+
+// This function looks at one more frame. On success the marker positions and motion models of the tracker are set.
+AutoInitializer::Status AutoInitializer::Step(Tracker& tracker)
+{
+	auto now = std::chrono::high_resolution_clock::now();
+	if (!started)
+	{
+		started = true;
+		startTime = now;
+	}
+	std::chrono::duration<double> elapsed = now - startTime;
+	if (elapsed.count() > AUTOINIT_BUDGET_SECONDS)
+	{
+		std::cout << "Automatic initialization found no stable constellation in " << elapsed.count() << " s" << std::endl;
+		return TimedOut;
+	}
+
+	const int numCameras = std::min(tracker.numCameras, NUM_CAMERAS);
+	// one scan per camera, each on its own thread as the segmentation of the frame loop
+	HANDLE threads[NUM_CAMERAS];
+	for (int i = 0; i < numCameras; i++)
+	{
+		paraList[i].camera_index = i;
+		paraList[i].initializerPtr = this;
+		paraList[i].trackerPtr = &tracker;
+		threads[i] = CreateThread(nullptr, 0, FindConstellationThread, &paraList[i], 0, nullptr);
+		assert(threads[i] != nullptr);
+	}
+	WaitForMultipleObjects(numCameras, threads, TRUE, INFINITE);
+	for (int i = 0; i < numCameras; i++)
+	{
+		CloseHandle(threads[i]);
+	}
+
+	for (int i = 0; i < numCameras; i++)
+	{
+		if (stableFrames[i] < AUTOINIT_STABLE_FRAMES)
+		{
+			return Running;
+		}
+	}
+	for (int i = 0; i < numCameras; i++)
+	{
+		for (int j = 0; j < Tracker::numMarkers; j++)
+		{
+			tracker.currentPos[i][j] = constellation[i][j];
+		}
+		// the constellation is ordered from top to bottom, colour classes give the real identities
+		tracker.IdentifyByColour(i);
+		// from now on the markers' windows keep them out of the clutter
+		candidates[i].clear();
+		for (int j = 0; j < Tracker::numMarkers; j++)
+		{
+			std::cout << "Inital position: " << i << j << tracker.currentPos[i][j] << std::endl;
+		}
+	}
+	tracker.InitMotionModels();
+	tracker.TrackerAutoIntialized = true;
+	elapsed = std::chrono::high_resolution_clock::now() - startTime;
+	std::cout << "Automatic initialization succeed after " << elapsed.count() << " s" << std::endl;
+	return Found;
+}
+
+#if defined (_WIN32)
+DWORD WINAPI FindConstellationThread(LPVOID lpParam)
+{
+#endif
+	ConstellationParameters para = *((ConstellationParameters*)lpParam);
+	para.initializerPtr->FindConstellation(para.camera_index, para.trackerPtr->ReceivedImages[para.camera_index], Tracker::numMarkers);
+	return 0;
+}
+
+// This function chooses numMarkers blobs of one camera image. Blobs are sorted from top to bottom and
+// a dynamic program picks the subsequence whose blob areas are closest to the typical marker area and whose
+// steps from one marker to the next are closest to the typical spacing (both on a log scale).
+// The typical values are the medians of the numMarkers largest blobs.
+void AutoInitializer::FindConstellation(int camera_index, const cv::Mat& image, int numMarkers)
+{
+	std::vector<cv::Point> previous;
+	previous.swap(constellation[camera_index]);
+	BlobScanner& scan = scanner[camera_index];
+	scan.range = Tracker::thresholds[camera_index].Range();
+	scan.Scan(image, Tracker::AllowedMask(camera_index));
+
+	// markers are on the moving legs, once the background model saw motion blobs far from it are left out
+	const BackgroundModel& model = Tracker::background[camera_index];
+	const bool motionPrior = model.Ready() && model.SawMotion();
+	std::vector<Blob> blobs;
+	candidates[camera_index].clear();
+	for (size_t k = 0; k < scan.blobs.size(); k++)
+	{
+		cv::Rect near = scan.blobs[k].box + cv::Size(2 * MARKER_RADIUS, 2 * MARKER_RADIUS) - cv::Point(MARKER_RADIUS, MARKER_RADIUS);
+		if (scan.blobs[k].area >= AUTOINIT_MIN_AREA && (!motionPrior || model.Moved(near)))
+		{
+			blobs.push_back(scan.blobs[k]);
+			candidates[camera_index].push_back(near);
+		}
+	}
+	const int n = numMarkers;
+	if (int(blobs.size()) < n || n < 1)
+	{
+		stableFrames[camera_index] = 0;
+		return;
+	}
+	std::sort(blobs.begin(), blobs.end(), [](const Blob& a, const Blob& b) { return a.area > b.area; });
+	if (int(blobs.size()) > 2 * n + AUTOINIT_EXTRA_CANDIDATES)
+	{
+		blobs.resize(2 * n + AUTOINIT_EXTRA_CANDIDATES);
+	}
+
+	// typical area and spacing from the n largest blobs
+	std::vector<Blob> largest(blobs.begin(), blobs.begin() + n);
+	const double typicalArea = largest[n / 2].area;
+	std::sort(largest.begin(), largest.end(), [](const Blob& a, const Blob& b) { return a.Centroid().y < b.Centroid().y; });
+	std::vector<double> gaps;
+	for (int k = 1; k < n; k++)
+	{
+		gaps.push_back(cv::norm(largest[k].Centroid() - largest[k - 1].Centroid()));
+	}
+	std::sort(gaps.begin(), gaps.end());
+	const double typicalGap = gaps.empty() ? 1.0 : std::max(gaps[gaps.size() / 2], 1.0);
+
+	std::sort(blobs.begin(), blobs.end(), [](const Blob& a, const Blob& b) { return a.Centroid().y < b.Centroid().y; });
+	const int K = int(blobs.size());
+	std::vector<double> unary(K);
+	for (int k = 0; k < K; k++)
+	{
+		double r = std::log(blobs[k].area / typicalArea);
+		unary[k] = r * r;
+	}
+	// cost[m * K + k]: best sequence of m + 1 markers that ends with blob k
+	const double inf = std::numeric_limits<double>::max();
+	std::vector<double> cost(size_t(n) * K, inf);
+	std::vector<int> from(size_t(n) * K, -1);
+	for (int k = 0; k < K; k++)
+	{
+		cost[k] = unary[k];
+	}
+	for (int m = 1; m < n; m++)
+	{
+		for (int k = m; k < K; k++)
+		{
+			for (int i = m - 1; i < k; i++)
+			{
+				double before = cost[size_t(m - 1) * K + i];
+				if (before == inf)
+				{
+					continue;
+				}
+				double r = std::log(std::max(cv::norm(blobs[k].Centroid() - blobs[i].Centroid()), 1.0) / typicalGap);
+				double total = before + r * r + unary[k];
+				if (total < cost[size_t(m) * K + k])
+				{
+					cost[size_t(m) * K + k] = total;
+					from[size_t(m) * K + k] = i;
+				}
+			}
+		}
+	}
+	int last = -1;
+	for (int k = n - 1; k < K; k++)
+	{
+		if (last < 0 || cost[size_t(n - 1) * K + k] < cost[size_t(n - 1) * K + last])
+		{
+			last = k;
+		}
+	}
+	std::vector<cv::Point> chosen(n);
+	for (int m = n - 1; m >= 0; m--)
+	{
+		chosen[m] = blobs[last].Center();
+		last = from[size_t(m) * K + last];
+	}
+
+	// the constellation counts as stable while every marker stays close to where it was in the last frame
+	bool still = previous.size() == chosen.size();
+	for (size_t j = 0; j < chosen.size() && still; j++)
+	{
+		still = cv::norm(cv::Point2f(chosen[j] - previous[j])) <= AUTOINIT_MAX_MOTION;
+	}
+	stableFrames[camera_index] = still ? stableFrames[camera_index] + 1 : 1;
+	constellation[camera_index].swap(chosen);
+}
@@ -0,0 +1,116 @@
+// 背景模型：找出静止的红色干扰和反光点，并记录最近运动过的像素作为初始化的先验
+#include "BackgroundModel.hpp"
+#include "RigKernels.hpp"
+
+
+BackgroundModel::BackgroundModel()
+{
+	Reset();
+}
+
+void BackgroundModel::Reset()
+{
+	frames = 0;
+	phase = 0;
+	std::fill(movedPixels, movedPixels + BACKGROUND_STRIPES, 0);
+	median.release();
+}
+
+// This function updates the rows of this frame's stripe. windows are the regions where markers are or may be,
+// a marker standing still inside one must not become clutter. Static visits are only counted while countStatic is set,
+// range is the colour range the camera segments with.
+void BackgroundModel::Update(const cv::Mat& image, const BitMask* exclusions, const cv::Rect windows[], int numWindows, bool countStatic, const HsvRange& range)
+{
+	if (image.type() != CV_8UC3)
+	{
+		return;
+	}
+	if (median.size() != image.size())
+	{
+		Reset();
+		median.create(image.size(), CV_8UC1);
+		motionVisits = cv::Mat::zeros(image.size(), CV_8UC1);
+		staticVisits = cv::Mat::zeros(image.size(), CV_8UC1);
+		clutter.Create(image.cols, image.rows);
+		moved.Create(image.cols, image.rows);
+		allowed.Create(image.cols, image.rows);
+		std::fill(allowed.words.begin(), allowed.words.end(), ~MaskWord(0));
+		movedRow.create(1, image.cols, CV_8UC1);
+		clutterRow.create(1, image.cols, CV_8UC1);
+	}
+	const HsvTables& tables = HsvTables::Get();
+	const bool first = frames < BACKGROUND_STRIPES; // the first visit of a row starts its median
+	const cv::Rect wholeImage(0, 0, image.cols, image.rows);
+	int movedCount = 0;
+	for (int y = phase; y < image.rows; y += BACKGROUND_STRIPES)
+	{
+		const uchar* px = image.ptr<uchar>(y);
+		uchar* med = median.ptr<uchar>(y);
+		uchar* motion = motionVisits.ptr<uchar>(y);
+		uchar* still = staticVisits.ptr<uchar>(y);
+		uchar* movedOut = movedRow.ptr<uchar>(0);
+		uchar* clutterOut = clutterRow.ptr<uchar>(0);
+		// grey level, median and motion without branches, so the compiler can vectorize this loop
+		for (int x = 0; x < image.cols; x++)
+		{
+			const int grey = (77 * px[3 * x + RGB8::red] + 150 * px[3 * x + RGB8::green] + 29 * px[3 * x + RGB8::blue]) >> 8;
+			const int m = first ? grey : med[x];
+			const int diff = grey - m;
+			med[x] = uchar(m + (diff > 0) - (diff < 0));
+			const int moving = diff > BACKGROUND_MOTION_THRESHOLD || diff < -BACKGROUND_MOTION_THRESHOLD;
+			motion[x] = uchar(moving ? BACKGROUND_MOTION_VISITS : motion[x] - (motion[x] > 0));
+			movedOut[x] = uchar(-(motion[x] > 0));
+			movedCount += motion[x] > 0;
+			still[x] = uchar(moving ? 0 : still[x]);
+		}
+		// pixels that keep the marker colour or stay saturated count up to clutter
+		for (int x = 0; x < image.cols && countStatic; x++)
+		{
+			const uchar* p = px + 3 * x;
+			const bool suspicious = std::max(std::max(p[0], p[1]), p[2]) >= BACKGROUND_SPECULAR_LEVEL
+				|| ProductionRigKernels::InRange(p, range, tables);
+			still[x] = uchar(suspicious ? still[x] + (still[x] < 255) : 0);
+		}
+		for (int k = 0; k < numWindows; k++)
+		{
+			const cv::Rect w = windows[k] & wholeImage;
+			if (y >= w.y && y < w.y + w.height)
+			{
+				std::fill(still + w.x, still + w.x + w.width, 0);
+			}
+		}
+		for (int x = 0; x < image.cols; x++)
+		{
+			clutterOut[x] = uchar(-(still[x] >= BACKGROUND_STATIC_VISITS));
+		}
+		moved.Pack(movedRow, cv::Point(0, y));
+		clutter.Pack(clutterRow, cv::Point(0, y));
+		MaskWord* line = allowed.Row(y);
+		const MaskWord* clutterLine = clutter.Row(y);
+		const MaskWord* excluded = exclusions ? exclusions->Row(y) : NULL;
+		for (int wi = 0; wi < allowed.wordsPerRow; wi++)
+		{
+			line[wi] = (excluded ? excluded[wi] : ~MaskWord(0)) & ~clutterLine[wi];
+		}
+	}
+	movedPixels[phase] = movedCount;
+	phase = (phase + 1) % BACKGROUND_STRIPES;
+	frames++;
+}
+
+// whether anything in the image moved recently, without motion the motion prior says nothing
+bool BackgroundModel::SawMotion() const
+{
+	int count = 0;
+	for (int k = 0; k < BACKGROUND_STRIPES; k++)
+	{
+		count += movedPixels[k];
+	}
+	return count > 0;
+}
+
+bool BackgroundModel::Moved(const cv::Rect& region) const
+{
+	double sumX, sumY;
+	return !moved.empty() && moved.Moments(region, sumX, sumY) > 0;
+}
@@ -0,0 +1,225 @@
+// 用合成图像比较专用内核和通用实现的速度
+#include "Benchmark.hpp"
+#include "RigKernels.hpp"
+#include "SmallMath.h"
+#include "GaitExporter.h"
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+
+// This function returns the mean time of one call in microseconds
+template<class Function>
+static double TimePerCall(Function function, int repeats)
+{
+	function(); // warm up caches and the lookup tables
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		function();
+	}
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::micro> elapsed = stop - start;
+	return elapsed.count() / repeats;
+}
+
+static void Report(const char* name, const char* baselineName, double baseline, const char* fastName, double fast)
+{
+	std::cout << name << ": " << baselineName << " " << baseline << " us, " << fastName << " " << fast << " us, speedup " << baseline / fast << std::endl;
+}
+
+// a camera frame with sensor noise and red markers
+static cv::Mat SyntheticFrame(cv::RNG& rng)
+{
+	cv::Mat frame(800, 1280, CV_8UC3);
+	rng.fill(frame, cv::RNG::UNIFORM, cv::Scalar(0, 0, 0), cv::Scalar(120, 120, 120));
+	for (int k = 0; k < 40; k++)
+	{
+		cv::Point center(rng.uniform(0, frame.cols), rng.uniform(0, frame.rows));
+		cv::circle(frame, center, rng.uniform(4, 12), cv::Scalar(rng.uniform(200, 256), rng.uniform(0, 60), rng.uniform(0, 40)), -1);
+	}
+	return frame;
+}
+
+static bool BenchmarkThreshold(cv::RNG& rng)
+{
+	cv::Mat frame = SyntheticFrame(rng);
+	cv::Rect whole(0, 0, frame.cols, frame.rows);
+	BitMask reference, kernel;
+	reference.Create(frame.cols, frame.rows);
+	kernel.Create(frame.cols, frame.rows);
+	cv::Mat hsv, rangeRes;
+	double referenceTime = TimePerCall([&]()
+	{
+		cv::cvtColor(frame, hsv, CV_RGB2HSV);
+		cv::inRange(hsv, cv::Scalar(MIN_H_RED, 160, 80), cv::Scalar(MAX_H_RED, 255, 255), rangeRes);
+		reference.Pack(rangeRes, cv::Point(0, 0));
+	}, 50);
+	double kernelTime = TimePerCall([&]()
+	{
+		ProductionRigKernels::Threshold(frame, whole, MARKER_RANGE, NULL, kernel);
+	}, 50);
+	Report("Threshold 1280x800 RGB8", "cvtColor + inRange", referenceTime, "RigKernels::Threshold", kernelTime);
+	if (reference.words != kernel.words)
+	{
+		std::cout << "Threshold: the mask of RigKernels differs from cvtColor + inRange" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// the world frame transform of every marker of both pairs, through cv::Mat_ products as DataProcess did it
+// and through the fixed-size types, which allocate nothing
+static bool BenchmarkWorldTransform(cv::RNG& rng)
+{
+	const int pairs = NUM_CAMERAS / 2, markers = MAX_MARKERS;
+	const Mat33 rotation = ToMatrix(Normalized(Quat(rng.uniform(-1.0, 1.0), rng.uniform(-1.0, 1.0), rng.uniform(-1.0, 1.0), rng.uniform(-1.0, 1.0))));
+	const Vec3 transform(rng.uniform(-500.0, 500.0), rng.uniform(-500.0, 500.0), rng.uniform(-3000.0, -1000.0));
+	cv::Mat_<double> rotationMat(3, 3);
+	for (int r = 0; r < 3; r++)
+	{
+		rotationMat(r, 0) = rotation.row[r].x;
+		rotationMat(r, 1) = rotation.row[r].y;
+		rotationMat(r, 2) = rotation.row[r].z;
+	}
+	cv::Point3d points[pairs][markers];
+	for (int i = 0; i < pairs; i++)
+	{
+		for (int j = 0; j < markers; j++)
+		{
+			points[i][j] = cv::Point3d(rng.uniform(-500.0, 500.0), rng.uniform(-500.0, 500.0), rng.uniform(1000.0, 3000.0));
+		}
+	}
+	cv::Point3d generic[pairs][markers];
+	Vec3 specialized[pairs][markers];
+	double genericTime = TimePerCall([&]()
+	{
+		for (int i = 0; i < pairs; i++)
+		{
+			for (int j = 0; j < markers; j++)
+			{
+				cv::Mat_<double> src(3, 1);
+				src(0, 0) = points[i][j].x + transform.x;
+				src(1, 0) = points[i][j].y + transform.y;
+				src(2, 0) = points[i][j].z + transform.z;
+				cv::Mat_<double> dst = rotationMat * src;
+				generic[i][j] = cv::Point3d(dst(0, 0), dst(1, 0), dst(2, 0));
+			}
+		}
+	}, 200);
+	double specializedTime = TimePerCall([&]()
+	{
+		for (int i = 0; i < pairs; i++)
+		{
+			const Mat34 toWorld(rotation, rotation * transform);
+			for (int j = 0; j < markers; j++)
+			{
+				specialized[i][j] = toWorld * Vec3(points[i][j].x, points[i][j].y, points[i][j].z);
+			}
+		}
+	}, 200);
+	Report("World frame transform of 2x64 markers", "cv::Mat_", genericTime, "fixed-size", specializedTime);
+	for (int i = 0; i < pairs; i++)
+	{
+		for (int j = 0; j < markers; j++)
+		{
+			const Vec3 difference = specialized[i][j] - Vec3(generic[i][j].x, generic[i][j].y, generic[i][j].z);
+			if (Norm(difference) > 1e-9 * Norm(specialized[i][j]))
+			{
+				std::cout << "World frame transform: marker " << j << " of pair " << i << " differs by " << Norm(difference) << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// the gait export at twice the camera rate: every frame goes through GaitExporter::Append on this thread while the
+// writer thread formats and writes the blocks. Append must stay far below the frame period, no frame may be dropped
+// and the file must hold every frame once Close returns, for the CSV, C3D and column store formats.
+static bool BenchmarkGaitExport(cv::RNG& rng)
+{
+	const double cameraRate = 200.0, rate = 2 * cameraRate;
+	const int markers = 6, frames = 4 * GAIT_BLOCK_RECORDS;
+	const char* paths[3] = { "GaitBenchmark.csv", "GaitBenchmark.c3d", "GaitBenchmark.gaitcol" };
+	std::vector<std::string> names;
+	for (int j = 0; j < markers; j++)
+	{
+		names.push_back(cv::format("marker%d", j));
+	}
+	Vec3 positions[GAIT_PAIRS][MAX_MARKERS];
+	double residual[GAIT_PAIRS][MAX_MARKERS];
+	ViewMask used[GAIT_PAIRS][MAX_MARKERS];
+	double hip[GAIT_PAIRS], knee[GAIT_PAIRS], ankle[GAIT_PAIRS];
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		for (int j = 0; j < markers; j++)
+		{
+			positions[i][j] = Vec3(rng.uniform(-500.0, 500.0), rng.uniform(-500.0, 500.0), rng.uniform(0.0, 1000.0));
+			residual[i][j] = rng.uniform(0.0, 2.0);
+			used[i][j] = ViewMask(3) << (2 * i);
+		}
+		hip[i] = rng.uniform(-20.0, 40.0);
+		knee[i] = rng.uniform(0.0, 70.0);
+		ankle[i] = rng.uniform(60.0, 120.0);
+	}
+	bool success = true;
+	for (int f = 0; f < 3; f++)
+	{
+		GaitExporter exporter;
+		if (!exporter.Open(paths[f], names))
+		{
+			success = false;
+			continue;
+		}
+		int appended = 0;
+		double appendTotal = 0, appendMax = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int k = 0; k < frames; k++)
+		{
+			// frames arrive at the pace of the cameras, the frame loop does not wait for the writer
+			const auto due = start + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(k / rate));
+			while (std::chrono::high_resolution_clock::now() < due)
+			{
+			}
+			const auto before = std::chrono::high_resolution_clock::now();
+			appended += exporter.Append(k / rate, positions, residual, used, hip, knee, ankle) ? 1 : 0;
+			std::chrono::duration<double, std::micro> took = std::chrono::high_resolution_clock::now() - before;
+			appendTotal += took.count();
+			appendMax = std::max(appendMax, took.count());
+		}
+		const auto closing = std::chrono::high_resolution_clock::now();
+		exporter.Close();
+		std::chrono::duration<double, std::milli> flush = std::chrono::high_resolution_clock::now() - closing;
+		std::cout << "Gait export to " << paths[f] << " at " << rate << " fps: Append " << appendTotal / frames << " us mean, "
+			<< appendMax << " us max, " << appended << " of " << frames << " frames kept, last block written " << flush.count() << " ms after Close" << std::endl;
+		if (f == 0)
+		{
+			std::ifstream written(paths[f]);
+			int lines = 0;
+			std::string line;
+			while (std::getline(written, line))
+			{
+				lines++;
+			}
+			if (lines != frames + 1)
+			{
+				std::cout << "Gait export: the CSV file holds " << lines - 1 << " of " << frames << " frames" << std::endl;
+				success = false;
+			}
+		}
+		std::remove(paths[f]);
+		success = appended == frames && success;
+	}
+	return success;
+}
+
+int RunBenchmarks()
+{
+	cv::RNG rng(20200401);
+	bool success = BenchmarkThreshold(rng);
+	success = BenchmarkWorldTransform(rng) && success;
+	success = BenchmarkGaitExport(rng) && success;
+	return success ? 0 : -1;
+}
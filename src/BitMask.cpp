@@ -0,0 +1,401 @@
+// 每个像素一位的二值图，形态学运算和连通域标记都直接在压缩后的行上进行
+#include "BitMask.hpp"
+#include <algorithm>
+
+// bits of word wi that lie in the columns x0 <= x < x1
+static inline MaskWord SpanMask(int wi, int x0, int x1)
+{
+	int lo = std::max(x0 - wi * WORD_BITS, 0);
+	int hi = std::min(x1 - wi * WORD_BITS, WORD_BITS);
+	if (hi <= lo)
+	{
+		return 0;
+	}
+	MaskWord upper = hi == WORD_BITS ? ~MaskWord(0) : ((MaskWord(1) << hi) - 1);
+	return upper & ~((MaskWord(1) << lo) - 1);
+}
+
+// This function dilates (OR) or erodes (AND) one row horizontally by radius pixels with word-wide shifts.
+// Words beyond the span are taken as fill.
+static void HorizontalPass(const MaskWord* in, MaskWord* out, int numWords, int radius, bool dilate, MaskWord fill)
+{
+	for (int w = 0; w < numWords; w++)
+	{
+		MaskWord prev = w > 0 ? in[w - 1] : fill;
+		MaskWord next = w + 1 < numWords ? in[w + 1] : fill;
+		MaskWord acc = in[w];
+		for (int k = 1; k <= radius; k++)
+		{
+			MaskWord fromRight = (in[w] >> k) | (next << (WORD_BITS - k)); // pixel x sees x + k
+			MaskWord fromLeft = (in[w] << k) | (prev >> (WORD_BITS - k)); // pixel x sees x - k
+			acc = dilate ? (acc | fromRight | fromLeft) : (acc & fromRight & fromLeft);
+		}
+		out[w] = acc;
+	}
+}
+
+
+RunLabeler::RunLabeler()
+{
+	Reset();
+}
+
+void RunLabeler::Reset()
+{
+	runs.clear();
+	parent.clear();
+	partial.clear();
+	previousBegin = previousEnd = currentBegin = scan = 0;
+	row = -2;
+}
+
+void RunLabeler::BeginRow(int y)
+{
+	if (y == row + 1)
+	{
+		previousBegin = currentBegin;
+		previousEnd = runs.size();
+	}
+	else
+	{
+		previousBegin = previousEnd = runs.size();
+	}
+	currentBegin = runs.size();
+	scan = previousBegin;
+	row = y;
+}
+
+int RunLabeler::Find(int label)
+{
+	while (parent[label] != label)
+	{
+		parent[label] = parent[parent[label]];
+		label = parent[label];
+	}
+	return label;
+}
+
+void RunLabeler::AddRun(int x0, int x1)
+{
+	// a run of the row above touches [x0, x1) when it covers any of x0 - 1 ... x1 (8-connectivity)
+	while (scan < previousEnd && runs[scan].x1 < x0)
+	{
+		scan++;
+	}
+	int label = -1;
+	for (size_t p = scan; p < previousEnd && runs[p].x0 <= x1; p++)
+	{
+		int other = Find(runs[p].label);
+		if (label < 0)
+		{
+			label = other;
+		}
+		else if (other != label)
+		{
+			parent[std::max(other, label)] = std::min(other, label);
+			label = std::min(other, label);
+		}
+	}
+	if (label < 0)
+	{
+		label = int(parent.size());
+		parent.push_back(label);
+		Blob blob;
+		blob.area = 0;
+		blob.sumX = blob.sumY = 0;
+		blob.box = cv::Rect(x0, row, x1 - x0, 1);
+		partial.push_back(blob);
+	}
+	Run run = { x0, x1, label };
+	runs.push_back(run);
+
+	Blob& blob = partial[label];
+	int length = x1 - x0;
+	int bx0 = std::min(blob.box.x, x0), by0 = std::min(blob.box.y, row);
+	int bx1 = std::max(blob.box.x + blob.box.width, x1), by1 = std::max(blob.box.y + blob.box.height, row + 1);
+	blob.box = cv::Rect(bx0, by0, bx1 - bx0, by1 - by0);
+	blob.area += length;
+	blob.sumX += 0.5 * (x0 + x1 - 1) * length;
+	blob.sumY += double(row) * length;
+}
+
+// This function joins the statistics of all labels that were merged into one blob
+void RunLabeler::Finish(std::vector<Blob>& blobs)
+{
+	blobs.clear();
+	std::vector<int> index(parent.size(), -1);
+	for (size_t label = 0; label < parent.size(); label++)
+	{
+		int root = Find(int(label));
+		const Blob& part = partial[label];
+		if (index[root] < 0)
+		{
+			index[root] = int(blobs.size());
+			blobs.push_back(part);
+			continue;
+		}
+		Blob& blob = blobs[index[root]];
+		int bx0 = std::min(blob.box.x, part.box.x), by0 = std::min(blob.box.y, part.box.y);
+		int bx1 = std::max(blob.box.x + blob.box.width, part.box.x + part.box.width);
+		int by1 = std::max(blob.box.y + blob.box.height, part.box.y + part.box.height);
+		blob.box = cv::Rect(bx0, by0, bx1 - bx0, by1 - by0);
+		blob.area += part.area;
+		blob.sumX += part.sumX;
+		blob.sumY += part.sumY;
+	}
+}
+
+
+BitMask::BitMask() :width(0), height(0), wordsPerRow(0)
+{
+}
+
+void BitMask::Create(int width_, int height_)
+{
+	width = width_;
+	height = height_;
+	wordsPerRow = (width + WORD_BITS - 1) / WORD_BITS;
+	words.assign(size_t(wordsPerRow) * height, 0);
+}
+
+void BitMask::Clear()
+{
+	std::fill(words.begin(), words.end(), 0);
+}
+
+void BitMask::Clear(const cv::Rect& region)
+{
+	cv::Rect r = region & cv::Rect(0, 0, width, height);
+	if (r.area() <= 0)
+	{
+		return;
+	}
+	int wa = r.x / WORD_BITS, wb = (r.x + r.width - 1) / WORD_BITS;
+	for (int y = r.y; y < r.y + r.height; y++)
+	{
+		MaskWord* line = Row(y);
+		for (int wi = wa; wi <= wb; wi++)
+		{
+			line[wi] &= ~SpanMask(wi, r.x, r.x + r.width);
+		}
+	}
+}
+
+// This function keeps only the bits inside the region that are also set in the other mask of the same size
+void BitMask::And(const BitMask& other, const cv::Rect& region)
+{
+	cv::Rect r = region & cv::Rect(0, 0, width, height);
+	if (r.area() <= 0)
+	{
+		return;
+	}
+	int wa = r.x / WORD_BITS, wb = (r.x + r.width - 1) / WORD_BITS;
+	for (int y = r.y; y < r.y + r.height; y++)
+	{
+		MaskWord* line = Row(y);
+		const MaskWord* keep = other.Row(y);
+		for (int wi = wa; wi <= wb; wi++)
+		{
+			line[wi] &= keep[wi] | ~SpanMask(wi, r.x, r.x + r.width);
+		}
+	}
+}
+
+// This function writes an 8-bit mask (non-zero is foreground) into the bits at the given position
+void BitMask::Pack(const cv::Mat& mask, cv::Point at)
+{
+	for (int j = 0; j < mask.rows; j++)
+	{
+		const uchar* data = mask.ptr<uchar>(j);
+		MaskWord* line = Row(at.y + j);
+		int x = at.x;
+		int i = 0;
+		while (i < mask.cols)
+		{
+			int wi = x / WORD_BITS;
+			int bit = x % WORD_BITS;
+			int count = std::min(WORD_BITS - bit, mask.cols - i);
+			MaskWord value = 0;
+			for (int k = 0; k < count; k++)
+			{
+				value |= MaskWord(data[i + k] != 0) << (bit + k);
+			}
+			MaskWord span = SpanMask(wi, x, x + count);
+			line[wi] = (line[wi] & ~span) | value;
+			x += count;
+			i += count;
+		}
+	}
+}
+
+void BitMask::Unpack(cv::Mat& mask, const cv::Rect& region) const
+{
+	mask.create(region.height, region.width, CV_8UC1);
+	for (int j = 0; j < region.height; j++)
+	{
+		uchar* data = mask.ptr<uchar>(j);
+		for (int i = 0; i < region.width; i++)
+		{
+			data[i] = Get(region.x + i, region.y + j) ? 255 : 0;
+		}
+	}
+}
+
+// This function closes the mask inside the region with a kernelX x kernelY rectangle.
+// Dilation and erosion are separable: rows are shifted and ORed/ANDed word by word, then whole rows are ORed/ANDed.
+// Pixels outside the image count as background for the dilation and as foreground for the erosion.
+void BitMask::Close(const cv::Rect& region, int kernelX, int kernelY)
+{
+	cv::Rect r = region & cv::Rect(0, 0, width, height);
+	if (r.area() <= 0)
+	{
+		return;
+	}
+	const int rx = kernelX / 2, ry = kernelY / 2;
+	const int xa = std::max(0, r.x - 2 * rx), xb = std::min(width, r.x + r.width + 2 * rx);
+	const int wa = xa / WORD_BITS, wb = (xb - 1) / WORD_BITS;
+	const int nw = wb - wa + 1;
+	const int ya = r.y - 2 * ry;
+	const int numIn = r.height + 4 * ry; // input rows needed for the region
+	const int numDilated = r.height + 2 * ry;
+	const MaskWord tail = (wb == wordsPerRow - 1 && width % WORD_BITS) ? ~SpanMask(wb, 0, width) : 0;
+
+	// horizontal dilation
+	scratchA.assign(size_t(numIn) * nw, 0);
+	for (int k = 0; k < numIn; k++)
+	{
+		int y = ya + k;
+		if (y >= 0 && y < height)
+		{
+			HorizontalPass(Row(y) + wa, &scratchA[size_t(k) * nw], nw, rx, true, 0);
+		}
+	}
+	// vertical dilation
+	scratchB.assign(size_t(numDilated) * nw, 0);
+	for (int d = 0; d < numDilated; d++)
+	{
+		MaskWord* out = &scratchB[size_t(d) * nw];
+		int y = ya + ry + d;
+		if (y < 0 || y >= height)
+		{
+			std::fill(out, out + nw, ~MaskWord(0));
+			continue;
+		}
+		for (int k = 0; k <= 2 * ry; k++)
+		{
+			const MaskWord* in = &scratchA[size_t(d + k) * nw];
+			for (int w = 0; w < nw; w++)
+			{
+				out[w] |= in[w];
+			}
+		}
+		out[nw - 1] |= tail;
+	}
+	// horizontal erosion
+	scratchA.resize(size_t(numDilated) * nw);
+	for (int d = 0; d < numDilated; d++)
+	{
+		HorizontalPass(&scratchB[size_t(d) * nw], &scratchA[size_t(d) * nw], nw, rx, false, ~MaskWord(0));
+	}
+	// vertical erosion, written back inside the region only
+	for (int e = 0; e < r.height; e++)
+	{
+		MaskWord* line = Row(r.y + e);
+		for (int w = 0; w < nw; w++)
+		{
+			MaskWord acc = ~MaskWord(0);
+			for (int k = 0; k <= 2 * ry; k++)
+			{
+				acc &= scratchA[size_t(e + k) * nw + w];
+			}
+			MaskWord span = SpanMask(wa + w, r.x, r.x + r.width);
+			line[wa + w] = (line[wa + w] & ~span) | (acc & span);
+		}
+	}
+}
+
+// This function finds the 8-connected blobs inside the region, runs are read straight from the packed rows
+void BitMask::ExtractBlobs(const cv::Rect& region, RunLabeler& labeler, std::vector<Blob>& blobs) const
+{
+	labeler.Reset();
+	cv::Rect r = region & cv::Rect(0, 0, width, height);
+	if (r.area() <= 0)
+	{
+		blobs.clear();
+		return;
+	}
+	const int x0 = r.x, x1 = r.x + r.width;
+	const int wa = x0 / WORD_BITS, wb = (x1 - 1) / WORD_BITS;
+	for (int y = r.y; y < r.y + r.height; y++)
+	{
+		labeler.BeginRow(y);
+		const MaskWord* line = Row(y);
+		int runStart = -1;
+		for (int wi = wa; wi <= wb; wi++)
+		{
+			const MaskWord span = SpanMask(wi, x0, x1);
+			const MaskWord w = line[wi] & span;
+			const int base = wi * WORD_BITS;
+			int pos = 0;
+			while (pos < WORD_BITS)
+			{
+				if (runStart < 0)
+				{
+					MaskWord rest = w >> pos;
+					if (!rest)
+					{
+						break;
+					}
+					pos += CountTrailingZeros(rest);
+					runStart = base + pos;
+				}
+				// zeros shifted in from the top mean the run goes on into the next word
+				MaskWord gaps = (~w & span) >> pos;
+				if (!gaps)
+				{
+					break;
+				}
+				pos += CountTrailingZeros(gaps);
+				labeler.AddRun(runStart, base + pos);
+				runStart = -1;
+			}
+		}
+		if (runStart >= 0)
+		{
+			labeler.AddRun(runStart, x1);
+		}
+	}
+	labeler.Finish(blobs);
+}
+
+// This function counts the foreground pixels inside the region and sums their coordinates, bit by bit of the packed rows
+int BitMask::Moments(const cv::Rect& region, double& sumX, double& sumY) const
+{
+	sumX = sumY = 0;
+	cv::Rect r = region & cv::Rect(0, 0, width, height);
+	if (r.area() <= 0)
+	{
+		return 0;
+	}
+	int count = 0;
+	const int x0 = r.x, x1 = r.x + r.width;
+	const int wa = x0 / WORD_BITS, wb = (x1 - 1) / WORD_BITS;
+	for (int y = r.y; y < r.y + r.height; y++)
+	{
+		const MaskWord* line = Row(y);
+		int rowCount = 0;
+		for (int wi = wa; wi <= wb; wi++)
+		{
+			MaskWord w = line[wi] & SpanMask(wi, x0, x1);
+			while (w)
+			{
+				sumX += wi * WORD_BITS + CountTrailingZeros(w);
+				rowCount++;
+				w &= w - 1;
+			}
+		}
+		sumY += double(y) * rowCount;
+		count += rowCount;
+	}
+	return count;
+}
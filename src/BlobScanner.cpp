@@ -0,0 +1,147 @@
+// 全画面逐行扫描：行程编码的前景、连通域合并以及均匀网格中的质心查找
+#include "BlobScanner.hpp"
+#include "RigKernels.hpp"
+#include <algorithm>
+
+
+BlobGrid::BlobGrid() :cols(0), rows(0)
+{
+}
+
+// counting sort of the centroids by cell
+void BlobGrid::Build(const std::vector<Blob>& blobs, cv::Size imageSize)
+{
+	cols = (imageSize.width + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE;
+	rows = (imageSize.height + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE;
+	centers.resize(blobs.size());
+	cellStart.assign(size_t(cols) * rows + 1, 0);
+	std::vector<int> cellOf(blobs.size());
+	for (size_t k = 0; k < blobs.size(); k++)
+	{
+		centers[k] = blobs[k].Centroid();
+		int cx = std::min(std::max(int(centers[k].x) / GRID_CELL_SIZE, 0), cols - 1);
+		int cy = std::min(std::max(int(centers[k].y) / GRID_CELL_SIZE, 0), rows - 1);
+		cellOf[k] = cy * cols + cx;
+		cellStart[cellOf[k] + 1]++;
+	}
+	for (size_t c = 1; c < cellStart.size(); c++)
+	{
+		cellStart[c] += cellStart[c - 1];
+	}
+	items.resize(blobs.size());
+	std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+	for (size_t k = 0; k < blobs.size(); k++)
+	{
+		items[fill[cellOf[k]]++] = int(k);
+	}
+}
+
+// This function returns the blobs whose centroid lies within maxDistance of the position.
+// Only the cells that overlap the search circle are visited.
+void BlobGrid::Within(cv::Point2f position, float maxDistance, std::vector<int>& found) const
+{
+	found.clear();
+	const float maxSquared = maxDistance * maxDistance;
+	int cx0 = std::max(int((position.x - maxDistance) / GRID_CELL_SIZE), 0);
+	int cx1 = std::min(int((position.x + maxDistance) / GRID_CELL_SIZE), cols - 1);
+	int cy0 = std::max(int((position.y - maxDistance) / GRID_CELL_SIZE), 0);
+	int cy1 = std::min(int((position.y + maxDistance) / GRID_CELL_SIZE), rows - 1);
+	for (int cy = cy0; cy <= cy1; cy++)
+	{
+		for (int cx = cx0; cx <= cx1; cx++)
+		{
+			int cell = cy * cols + cx;
+			for (int i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+			{
+				int k = items[i];
+				float dx = centers[k].x - position.x, dy = centers[k].y - position.y;
+				if (dx * dx + dy * dy <= maxSquared)
+				{
+					found.push_back(k);
+				}
+			}
+		}
+	}
+}
+
+
+BlobScanner::BlobScanner() :minArea(4), range(MARKER_RANGE)
+{
+}
+
+// This function finds the blobs of one image. Pixels not set in allowed (when given, same size as the image) are background.
+void BlobScanner::Scan(const cv::Mat& image, const BitMask* allowed)
+{
+	labeler.Reset();
+	const HsvTables& tables = HsvTables::Get();
+	for (int y = 0; y < image.rows; y++)
+	{
+		// one row at a time stays in cache from colour conversion to run extraction
+		if (image.type() == CV_8UC3)
+		{
+			rangeRow.create(1, image.cols, CV_8UC1);
+			const uchar* px = image.ptr<uchar>(y);
+			uchar* out = rangeRow.ptr<uchar>(0);
+			for (int x = 0; x < image.cols; x++, px += RGB8::channels)
+			{
+				out[x] = ProductionRigKernels::InRange(px, range, tables);
+			}
+		}
+		else
+		{
+			cv::cvtColor(image.row(y), hsvRow, CV_RGB2HSV);
+			cv::inRange(hsvRow, cv::Scalar(range.hMin, range.sMin, range.vMin), cv::Scalar(range.hMax, range.sMax, range.vMax), rangeRow);
+		}
+		if (allowed)
+		{
+			const MaskWord* keep = allowed->Row(y);
+			uchar* out = rangeRow.ptr<uchar>(0);
+			for (int x = 0; x < image.cols; x++)
+			{
+				out[x] &= -uchar((keep[x / WORD_BITS] >> (x % WORD_BITS)) & 1);
+			}
+		}
+		const uchar* data = rangeRow.ptr<uchar>(0);
+		labeler.BeginRow(y);
+		int runStart = -1, runEnd = -1;
+		for (int x = 0; x < image.cols; x++)
+		{
+			if (!data[x])
+			{
+				continue;
+			}
+			int x0 = x;
+			while (x < image.cols && data[x])
+			{
+				x++;
+			}
+			if (runStart >= 0 && x0 - runEnd <= RUN_GAP_FILL)
+			{
+				runEnd = x;
+			}
+			else
+			{
+				if (runStart >= 0)
+				{
+					labeler.AddRun(runStart, runEnd);
+				}
+				runStart = x0;
+				runEnd = x;
+			}
+		}
+		if (runStart >= 0)
+		{
+			labeler.AddRun(runStart, runEnd);
+		}
+	}
+	labeler.Finish(labeled);
+	blobs.clear();
+	for (size_t k = 0; k < labeled.size(); k++)
+	{
+		if (labeled[k].area >= minArea)
+		{
+			blobs.push_back(labeled[k]);
+		}
+	}
+	grid.Build(blobs, image.size());
+}
@@ -0,0 +1,274 @@
+// 把marker轨迹和关节角度逐帧写成C3D文件，结束时再补写文件头和参数
+#include "C3DWriter.h"
+#include "GaitRecord.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+const int C3D_INTEL = 84; // processor type of Intel byte order and IEEE floats
+const int C3D_CHAR = -1, C3D_INT16 = 2, C3D_FLOAT = 4; // parameter data types
+const int C3D_MAX_FRAMES16 = 65535; // longer trials keep their length in TRIAL:ACTUAL_END_FIELD
+
+// values are stored in the byte order of the host, the tracker runs on Intel machines only
+template<class T>
+static void Put(std::vector<char>& out, T value)
+{
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<class T>
+static void Set(std::vector<char>& out, size_t at, T value)
+{
+	std::memcpy(&out[at], &value, sizeof(T));
+}
+
+static int16_t Frames16(int frames)
+{
+	return int16_t(uint16_t(std::min(frames, C3D_MAX_FRAMES16)));
+}
+
+
+C3DWriter::C3DWriter() :numMarkers(0), lastRecord(0), dataStart(0)
+{
+}
+
+// This function writes header and parameters of an empty trial, the frames follow at the end of the file
+bool C3DWriter::Begin(std::FILE* file, const std::vector<std::string>& markerNames)
+{
+	names = markerNames;
+	numMarkers = int(names.size());
+	if (GAIT_PAIRS * numMarkers > 255)
+	{
+		std::cout << "C3D labels can list at most 255 points, " << GAIT_PAIRS * numMarkers << " requested" << std::endl;
+		return false;
+	}
+	// DATA_START is part of the parameters, their size does not depend on it
+	dataStart = 0;
+	BuildParameters(0, C3D_DEFAULT_RATE);
+	dataStart = 2 + int(parameters.size() / C3D_BLOCK);
+	BuildParameters(0, C3D_DEFAULT_RATE);
+	BuildHeader(0, C3D_DEFAULT_RATE);
+	return WriteSections(file);
+}
+
+// bytes of one frame: x, y, z and the camera/residual word of each point, then one sample of each angle
+size_t C3DWriter::FrameSize() const
+{
+	return sizeof(float) * (4 * GAIT_PAIRS * numMarkers + 3 * GAIT_PAIRS);
+}
+
+char* C3DWriter::EncodeFrame(const GaitRecord& record, char* out) const
+{
+	float* value = reinterpret_cast<float*>(out);
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		for (int j = 0; j < numMarkers; j++)
+		{
+			const Vec3& p = record.markers[i][j];
+			if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+			{
+				*value++ = 0;
+				*value++ = 0;
+				*value++ = 0;
+				*value++ = -1;
+				continue;
+			}
+			*value++ = float(p.x);
+			*value++ = float(p.y);
+			*value++ = float(p.z);
+			// the high byte names the cameras 1 to 7 that saw the point, the low byte is the residual in units of the scale
+			const int cameras = int(record.used[i][j] & ((1u << C3D_MAX_CAMERAS) - 1));
+			int residual = 0;
+			if (cameras != 0)
+			{
+				residual = int(std::min(255.0, std::max(1.0, std::floor(record.residual[i][j] / std::abs(C3D_POINT_SCALE) + 0.5))));
+			}
+			*value++ = float((cameras << 8) | residual);
+		}
+	}
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		*value++ = float(record.hip[i]);
+		*value++ = float(record.knee[i]);
+		*value++ = float(record.ankle[i]);
+	}
+	return reinterpret_cast<char*>(value);
+}
+
+// This function pads the frames to a whole block and overwrites header and parameters with the length of the trial
+// and the frame rate measured from the first and the last frame time
+bool C3DWriter::End(std::FILE* file, int frames, double firstTime, double lastTime)
+{
+	const float rate = frames > 1 && lastTime > firstTime ? float((frames - 1) / (lastTime - firstTime)) : C3D_DEFAULT_RATE;
+	std::fseek(file, 0, SEEK_END);
+	const long size = std::ftell(file);
+	const std::vector<char> padding((C3D_BLOCK - size % C3D_BLOCK) % C3D_BLOCK, 0);
+	if (!padding.empty() && std::fwrite(padding.data(), 1, padding.size(), file) != padding.size())
+	{
+		std::cout << "C3D: padding the frames failed" << std::endl;
+		return false;
+	}
+	BuildParameters(frames, rate);
+	BuildHeader(frames, rate);
+	std::fseek(file, 0, SEEK_SET);
+	return WriteSections(file);
+}
+
+// the first block, its 16-bit words are numbered from 1 as in the C3D manual
+void C3DWriter::BuildHeader(int frames, float rate)
+{
+	header.assign(C3D_BLOCK, 0);
+	header[0] = 2; // the parameters start in block 2
+	header[1] = 0x50;
+	Set(header, 2 * 1, int16_t(GAIT_PAIRS * numMarkers));
+	Set(header, 2 * 2, int16_t(3 * GAIT_PAIRS)); // analog samples in each frame
+	Set(header, 2 * 3, int16_t(1)); // first frame
+	Set(header, 2 * 4, Frames16(frames)); // last frame
+	Set(header, 2 * 5, int16_t(0)); // no gaps are filled
+	Set(header, 2 * 6, C3D_POINT_SCALE);
+	Set(header, 2 * 8, int16_t(dataStart));
+	Set(header, 2 * 9, int16_t(1)); // analog samples of each channel in each frame
+	Set(header, 2 * 10, rate);
+}
+
+void C3DWriter::BuildParameters(int frames, float rate)
+{
+	parameters.clear();
+	parameters.push_back(1);
+	parameters.push_back(0x50);
+	parameters.push_back(0); // number of blocks, set below
+	parameters.push_back(char(C3D_INTEL));
+
+	std::vector<std::string> labels, descriptions;
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		for (int j = 0; j < numMarkers; j++)
+		{
+			labels.push_back(std::string(LegName(i)) + "_" + names[j]);
+			descriptions.push_back(names[j] + " of the " + LegName(i) + " leg");
+		}
+	}
+	const int16_t points = int16_t(labels.size()), frames16 = Frames16(frames), start = int16_t(dataStart);
+	AddGroup(1, "POINT", "3D marker positions in the world frame");
+	AddParameter(1, "USED", C3D_INT16, std::vector<int>(), &points, "number of points");
+	AddParameter(1, "FRAMES", C3D_INT16, std::vector<int>(), &frames16, "number of frames");
+	AddParameter(1, "DATA_START", C3D_INT16, std::vector<int>(), &start, "first block of the frames");
+	AddParameter(1, "SCALE", C3D_FLOAT, std::vector<int>(), &C3D_POINT_SCALE, "negative for floating point data");
+	AddParameter(1, "RATE", C3D_FLOAT, std::vector<int>(), &rate, "frames per second");
+	AddParameter(1, "UNITS", C3D_CHAR, std::vector<int>(1, 2), "mm", "");
+	AddStrings(1, "LABELS", labels, "");
+	AddStrings(1, "DESCRIPTIONS", descriptions, "");
+
+	const char* joints[] = { "hip", "knee", "ankle" };
+	labels.clear();
+	descriptions.clear();
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			labels.push_back(std::string(LegName(i)) + "_" + joints[k]);
+			descriptions.push_back(std::string("sagittal ") + joints[k] + " angle of the " + LegName(i) + " leg");
+		}
+	}
+	const int16_t channels = int16_t(labels.size());
+	const std::vector<float> scale(channels, 1.0f);
+	const std::vector<int16_t> offset(channels, 0);
+	const float genericScale = 1.0f;
+	AddGroup(2, "ANALOG", "joint angles, one sample per frame");
+	AddParameter(2, "USED", C3D_INT16, std::vector<int>(), &channels, "number of channels");
+	AddStrings(2, "LABELS", labels, "");
+	AddStrings(2, "DESCRIPTIONS", descriptions, "");
+	AddStrings(2, "UNITS", std::vector<std::string>(channels, "deg"), "");
+	AddParameter(2, "SCALE", C3D_FLOAT, std::vector<int>(1, channels), scale.data(), "");
+	AddParameter(2, "OFFSET", C3D_INT16, std::vector<int>(1, channels), offset.data(), "");
+	AddParameter(2, "GEN_SCALE", C3D_FLOAT, std::vector<int>(), &genericScale, "");
+	AddParameter(2, "RATE", C3D_FLOAT, std::vector<int>(), &rate, "samples per second");
+
+	// the 32-bit frame numbers, as two 16-bit words low word first, hold trials longer than 65535 frames
+	const int16_t first[2] = { 1, 0 };
+	const int16_t last[2] = { int16_t(uint16_t(frames & 0xFFFF)), int16_t(uint16_t(frames >> 16)) };
+	AddGroup(3, "TRIAL", "");
+	AddParameter(3, "ACTUAL_START_FIELD", C3D_INT16, std::vector<int>(1, 2), first, "");
+	AddParameter(3, "ACTUAL_END_FIELD", C3D_INT16, std::vector<int>(1, 2), last, "");
+
+	// the last record links to nothing, then the section is padded to whole blocks
+	const size_t link = lastRecord + 2 + size_t(parameters[lastRecord]);
+	Set(parameters, link, int16_t(0));
+	parameters.resize((parameters.size() + C3D_BLOCK - 1) / C3D_BLOCK * C3D_BLOCK, 0);
+	parameters[2] = char(parameters.size() / C3D_BLOCK);
+}
+
+// group records have a negative id, each record links to the next by the byte distance from its link field
+void C3DWriter::AddGroup(int id, const char* name, const char* description)
+{
+	lastRecord = parameters.size();
+	const size_t descriptionLength = std::strlen(description);
+	parameters.push_back(char(std::strlen(name)));
+	parameters.push_back(char(-id));
+	parameters.insert(parameters.end(), name, name + std::strlen(name));
+	Put(parameters, int16_t(2 + 1 + descriptionLength));
+	parameters.push_back(char(descriptionLength));
+	parameters.insert(parameters.end(), description, description + descriptionLength);
+}
+
+// type is the size of one element, C3D_CHAR for text; an empty dimensions list is a scalar
+void C3DWriter::AddParameter(int id, const char* name, int type, const std::vector<int>& dimensions, const void* data, const char* description)
+{
+	lastRecord = parameters.size();
+	size_t count = 1;
+	for (size_t d = 0; d < dimensions.size(); d++)
+	{
+		count *= size_t(dimensions[d]);
+	}
+	const size_t bytes = count * size_t(std::abs(type));
+	const size_t descriptionLength = std::strlen(description);
+	parameters.push_back(char(std::strlen(name)));
+	parameters.push_back(char(id));
+	parameters.insert(parameters.end(), name, name + std::strlen(name));
+	Put(parameters, int16_t(2 + 1 + 1 + dimensions.size() + bytes + 1 + descriptionLength));
+	parameters.push_back(char(type));
+	parameters.push_back(char(dimensions.size()));
+	for (size_t d = 0; d < dimensions.size(); d++)
+	{
+		parameters.push_back(char(dimensions[d]));
+	}
+	const char* values = static_cast<const char*>(data);
+	parameters.insert(parameters.end(), values, values + bytes);
+	parameters.push_back(char(descriptionLength));
+	parameters.insert(parameters.end(), description, description + descriptionLength);
+}
+
+// a list of strings is a character matrix, every string padded with blanks to the longest
+void C3DWriter::AddStrings(int id, const char* name, const std::vector<std::string>& values, const char* description)
+{
+	size_t length = 1;
+	for (size_t k = 0; k < values.size(); k++)
+	{
+		length = std::max(length, values[k].size());
+	}
+	length = std::min(length, size_t(255));
+	std::string matrix;
+	for (size_t k = 0; k < values.size(); k++)
+	{
+		matrix += values[k].substr(0, length);
+		matrix.append(length - std::min(length, values[k].size()), ' ');
+	}
+	std::vector<int> dimensions;
+	dimensions.push_back(int(length));
+	dimensions.push_back(int(values.size()));
+	AddParameter(id, name, C3D_CHAR, dimensions, matrix.data(), description);
+}
+
+bool C3DWriter::WriteSections(std::FILE* file)
+{
+	if (std::fwrite(header.data(), 1, header.size(), file) != header.size() ||
+		std::fwrite(parameters.data(), 1, parameters.size(), file) != parameters.size())
+	{
+		std::cout << "C3D: writing header and parameters failed" << std::endl;
+		return false;
+	}
+	std::fflush(file);
+	return true;
+}
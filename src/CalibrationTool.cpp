@@ -0,0 +1,47 @@
+// 标定工具：从录制的棋盘格图像求出每个相机的内参、畸变和外参，写入跟踪程序启动时读取的标定文件
+#include "ChessboardCalibration.h"
+#include <cstdlib>
+#include <iostream>
+
+
+// Calibrate <frame pattern> <corners per row> <corners per column> <square size in mm> [--rig <file>] [--output <file>]
+// --rig <file> reads the crop offsets, binning and pairs of the cameras from an existing calibration,
+// --output <file> writes the calibration to another file than RigCalibration.yml
+int main(int argc, char** argv)
+{
+	if (argc < 5)
+	{
+		std::cout << "Usage: " << argv[0] << " <frame pattern, e.g. calibration/cam%d_%04d.png> <corners per row> <corners per column> <square size in mm>"
+			<< " [--rig <file>] [--output <file>]" << std::endl;
+		return -1;
+	}
+	const std::string pattern = argv[1];
+	const cv::Size boardSize(std::atoi(argv[2]), std::atoi(argv[3]));
+	const double squareSize = std::atof(argv[4]);
+	std::string outputPath = "RigCalibration.yml";
+	RigCalibration rig;
+	for (int k = 5; k < argc; k++)
+	{
+		std::string option(argv[k]);
+		if (option == "--rig" && k + 1 < argc && !rig.Load(argv[++k]))
+		{
+			std::cout << "Using the default rig layout" << std::endl;
+		}
+		if (option == "--output" && k + 1 < argc)
+		{
+			outputPath = argv[++k];
+		}
+	}
+	ChessboardCalibration calibration(boardSize, squareSize);
+	if (calibration.DetectCorners(pattern, rig) == 0)
+	{
+		std::cout << "No frames match " << pattern << std::endl;
+		return -1;
+	}
+	if (!calibration.Solve(rig))
+	{
+		std::cout << "Some cameras could not be calibrated, they keep their previous model" << std::endl;
+	}
+	calibration.Verify(rig);
+	return rig.Save(outputPath) ? 0 : -1;
+}
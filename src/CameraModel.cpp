@@ -0,0 +1,75 @@
+#include "CameraModel.h"
+
+
+CameraModel::CameraModel() :K(cv::Matx33d::eye()), R(cv::Matx33d::eye()), t(0, 0, 0), binning(BINNING), pair(0)
+{
+}
+
+
+CameraModel::~CameraModel()
+{
+}
+
+// 因为标定相机时是全尺寸，所以需要转换回全尺寸下的图像坐标
+cv::Point2d CameraModel::ToSensor(const cv::Point2d& image) const
+{
+	return cv::Point2d(binning * (image.x + offset.x), binning * (image.y + offset.y));
+}
+
+cv::Point2d CameraModel::ToImage(const cv::Point2d& sensor) const
+{
+	return cv::Point2d(sensor.x / binning - offset.x, sensor.y / binning - offset.y);
+}
+
+cv::Point3d CameraModel::ToCamera(const cv::Point3d& p) const
+{
+	cv::Vec3d pc = R * cv::Vec3d(p.x, p.y, p.z) + t;
+	return cv::Point3d(pc[0], pc[1], pc[2]);
+}
+
+// This function applies the radial and tangential distortion to a point of the normalized image plane, as cv::projectPoints does
+cv::Point2d CameraModel::Distort(const cv::Point2d& normalized) const
+{
+	const double x = normalized.x, y = normalized.y;
+	const double r2 = x * x + y * y;
+	const double radial = 1 + r2 * (distortion[0] + r2 * (distortion[1] + r2 * distortion[4]));
+	return cv::Point2d(x * radial + 2 * distortion[2] * x * y + distortion[3] * (r2 + 2 * x * x),
+		y * radial + distortion[2] * (r2 + 2 * y * y) + 2 * distortion[3] * x * y);
+}
+
+// derivative of Distort with respect to the normalized point
+cv::Matx22d CameraModel::DistortJacobian(const cv::Point2d& normalized) const
+{
+	const double x = normalized.x, y = normalized.y;
+	const double r2 = x * x + y * y;
+	const double radial = 1 + r2 * (distortion[0] + r2 * (distortion[1] + r2 * distortion[4]));
+	const double dRadial = 2 * (distortion[0] + r2 * (2 * distortion[1] + 3 * r2 * distortion[4])); // d radial / d r2 times 2
+	const double p1 = distortion[2], p2 = distortion[3];
+	return cv::Matx22d(radial + x * x * dRadial + 2 * p1 * y + 6 * p2 * x, x * y * dRadial + 2 * p1 * x + 2 * p2 * y,
+		x * y * dRadial + 2 * p1 * x + 2 * p2 * y, radial + y * y * dRadial + 6 * p1 * y + 2 * p2 * x);
+}
+
+// This function projects a point of the pair frame into the image
+cv::Point2d CameraModel::Project(const cv::Point3d& p) const
+{
+	cv::Point3d pc = ToCamera(p);
+	cv::Point2d distorted = Distort(cv::Point2d(pc.x / pc.z, pc.y / pc.z));
+	cv::Point2d sensor(K(0, 0) * distorted.x + K(0, 2), K(1, 1) * distorted.y + K(1, 2));
+	return ToImage(sensor);
+}
+
+// derivative of Project with respect to the point, used to map 3D covariance into the image
+cv::Matx23d CameraModel::ProjectJacobian(const cv::Point3d& p) const
+{
+	cv::Point3d pc = ToCamera(p);
+	double iz = 1.0 / pc.z;
+	cv::Matx23d normalized(iz, 0, -pc.x * iz * iz,
+		0, iz, -pc.y * iz * iz);
+	cv::Matx22d scale(K(0, 0) / binning, 0, 0, K(1, 1) / binning);
+	return scale * DistortJacobian(cv::Point2d(pc.x * iz, pc.y * iz)) * normalized * R;
+}
+
+bool CameraModel::InFront(const cv::Point3d& p) const
+{
+	return ToCamera(p).z > 1.0;
+}
@@ -0,0 +1,257 @@
+// 用棋盘格图像标定每个相机的内参和畸变，以及每个相机相对于相机对第一个相机的外参
+#include "ChessboardCalibration.h"
+#include "Triangulation.h"
+#include <fstream>
+#include <iostream>
+
+
+static std::string FramePath(const std::string& pattern, int camera, int frame)
+{
+	return cv::format(pattern.c_str(), camera, frame);
+}
+
+// Finds the board in the frames of a range of jobs, job k is frame k / numCameras of camera k % numCameras.
+// Every job writes only its own corner list, so the jobs run in parallel without locks.
+class CornerDetector : public cv::ParallelLoopBody
+{
+public:
+	CornerDetector(ChessboardCalibration& calibration_, const RigCalibration& rig_, const std::string& pattern_)
+		:calibration(calibration_), rig(rig_), pattern(pattern_)
+	{
+	}
+
+	void operator()(const cv::Range& range) const
+	{
+		for (int job = range.start; job < range.end; job++)
+		{
+			const int c = job % rig.numCameras, f = job / rig.numCameras;
+			cv::Mat gray = cv::imread(FramePath(pattern, c, f), cv::IMREAD_GRAYSCALE);
+			if (gray.empty())
+			{
+				continue;
+			}
+			calibration.imageSizes[c][f] = gray.size();
+			const CameraModel& camera = rig.cameras[c];
+			std::vector<cv::Point2f> found;
+			int flags = cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE | cv::CALIB_CB_FAST_CHECK;
+			if (!cv::findChessboardCorners(gray, calibration.boardSize, found, flags))
+			{
+				continue;
+			}
+			cv::cornerSubPix(gray, found, cv::Size(5, 5), cv::Size(-1, -1), cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.01));
+			for (size_t k = 0; k < found.size(); k++)
+			{
+				cv::Point2d sensor = camera.ToSensor(cv::Point2d(found[k].x, found[k].y));
+				found[k] = cv::Point2f(float(sensor.x), float(sensor.y));
+			}
+			calibration.corners[c][f].swap(found);
+		}
+	}
+
+private:
+	ChessboardCalibration& calibration;
+	const RigCalibration& rig;
+	const std::string& pattern;
+};
+
+
+ChessboardCalibration::ChessboardCalibration(const cv::Size& boardSize_, double squareSize_)
+	:boardSize(boardSize_), squareSize(squareSize_), numFrames(0)
+{
+}
+
+// This function finds the board in every frame of every camera and returns the number of frames.
+// Frames are counted until the first frame camera 0 has no file for.
+int ChessboardCalibration::DetectCorners(const std::string& pattern, const RigCalibration& rig)
+{
+	numFrames = 0;
+	while (std::ifstream(FramePath(pattern, 0, numFrames).c_str()).good())
+	{
+		numFrames++;
+	}
+	for (int c = 0; c < NUM_CAMERAS; c++)
+	{
+		corners[c].assign(numFrames, std::vector<cv::Point2f>());
+		imageSizes[c].assign(numFrames, cv::Size());
+		sensorSize[c] = cv::Size();
+	}
+	cv::parallel_for_(cv::Range(0, numFrames * rig.numCameras), CornerDetector(*this, rig, pattern));
+	for (int c = 0; c < rig.numCameras; c++)
+	{
+		// the sensor size comes from the first frame of the camera that loads, whichever thread read it
+		const CameraModel& camera = rig.cameras[c];
+		for (int f = 0; f < numFrames; f++)
+		{
+			const cv::Size& image = imageSizes[c][f];
+			if (image.area() > 0)
+			{
+				sensorSize[c] = cv::Size(cvRound(camera.binning * (image.width + camera.offset.x)), cvRound(camera.binning * (image.height + camera.offset.y)));
+				break;
+			}
+		}
+		int views = 0;
+		for (int f = 0; f < numFrames; f++)
+		{
+			views += corners[c][f].empty() ? 0 : 1;
+		}
+		std::cout << "Camera " << c << " sees the board in " << views << " of " << numFrames << " frames" << std::endl;
+	}
+	return numFrames;
+}
+
+// This function solves the intrinsics and distortion of every camera on its own, then the pose of every camera relative
+// to the first camera of its pair with the intrinsics fixed. Cameras without enough views keep their model.
+bool ChessboardCalibration::Solve(RigCalibration& rig) const
+{
+	std::vector<cv::Point3f> board;
+	for (int y = 0; y < boardSize.height; y++)
+	{
+		for (int x = 0; x < boardSize.width; x++)
+		{
+			board.push_back(cv::Point3f(float(x * squareSize), float(y * squareSize), 0));
+		}
+	}
+	bool success = true;
+	bool calibrated[NUM_CAMERAS] = { false };
+	for (int c = 0; c < rig.numCameras; c++)
+	{
+		std::vector<std::vector<cv::Point3f>> objectPoints;
+		std::vector<std::vector<cv::Point2f>> imagePoints;
+		for (int f = 0; f < numFrames; f++)
+		{
+			if (!corners[c][f].empty())
+			{
+				objectPoints.push_back(board);
+				imagePoints.push_back(corners[c][f]);
+			}
+		}
+		if (int(imagePoints.size()) < MIN_CALIBRATION_VIEWS)
+		{
+			std::cout << "Camera " << c << " has " << imagePoints.size() << " views of the board, " << MIN_CALIBRATION_VIEWS << " are needed" << std::endl;
+			success = false;
+			continue;
+		}
+		cv::Mat K, distortion;
+		std::vector<cv::Mat> rvecs, tvecs;
+		double rms = cv::calibrateCamera(objectPoints, imagePoints, sensorSize[c], K, distortion, rvecs, tvecs);
+		std::cout << "Camera " << c << " intrinsics: " << rms << " px RMS over " << imagePoints.size() << " views" << std::endl;
+		K.convertTo(K, CV_64F);
+		distortion.convertTo(distortion, CV_64F);
+		rig.cameras[c].K = cv::Matx33d(K.ptr<double>());
+		rig.cameras[c].distortion = cv::Vec<double, 5>(distortion.ptr<double>());
+		calibrated[c] = true;
+	}
+	for (int c = 0; c < rig.numCameras; c++)
+	{
+		int first = 0;
+		while (rig.cameras[first].pair != rig.cameras[c].pair)
+		{
+			first++;
+		}
+		if (first == c)
+		{
+			rig.cameras[c].R = cv::Matx33d::eye();
+			rig.cameras[c].t = cv::Vec3d(0, 0, 0);
+			continue;
+		}
+		if (!calibrated[c] || !calibrated[first])
+		{
+			success = false;
+			continue;
+		}
+		std::vector<std::vector<cv::Point3f>> objectPoints;
+		std::vector<std::vector<cv::Point2f>> firstPoints, secondPoints;
+		for (int f = 0; f < numFrames; f++)
+		{
+			if (!corners[first][f].empty() && !corners[c][f].empty())
+			{
+				objectPoints.push_back(board);
+				firstPoints.push_back(corners[first][f]);
+				secondPoints.push_back(corners[c][f]);
+			}
+		}
+		if (int(objectPoints.size()) < MIN_CALIBRATION_VIEWS)
+		{
+			std::cout << "Cameras " << first << " and " << c << " see the board together in " << objectPoints.size() << " frames, " << MIN_CALIBRATION_VIEWS << " are needed" << std::endl;
+			success = false;
+			continue;
+		}
+		cv::Mat K1(rig.cameras[first].K), d1(rig.cameras[first].distortion), K2(rig.cameras[c].K), d2(rig.cameras[c].distortion);
+		cv::Mat R, t, E, F;
+		double rms = cv::stereoCalibrate(objectPoints, firstPoints, secondPoints, K1, d1, K2, d2, sensorSize[first], R, t, E, F, cv::CALIB_FIX_INTRINSIC);
+		std::cout << "Camera " << c << " relative to camera " << first << ": " << rms << " px RMS over " << objectPoints.size() << " views, baseline " << cv::norm(t) << " mm" << std::endl;
+		R.convertTo(R, CV_64F);
+		t.convertTo(t, CV_64F);
+		rig.cameras[c].R = cv::Matx33d(R.ptr<double>());
+		rig.cameras[c].t = cv::Vec3d(t.ptr<double>());
+	}
+	return success;
+}
+
+// This function triangulates every board corner seen by two or more cameras of a pair with the solved rig, all frames
+// in one batch, and prints the reprojection error of each pair. A pair whose error is far above the RMS of
+// stereoCalibrate has a camera that moved during the recording or corners matched to the wrong board.
+void ChessboardCalibration::Verify(const RigCalibration& rig) const
+{
+	MultiViewTriangulator triangulator;
+	triangulator.SetCameras(rig.cameras, rig.numCameras);
+	const int numCorners = boardSize.area();
+	ObservationBatch batch;
+	batch.Reserve(size_t(numFrames) * numCorners * triangulator.numGroups);
+	std::vector<int> group;
+	std::vector<cv::Point2f> undistorted[NUM_CAMERAS];
+	cv::Point2d sensor[NUM_CAMERAS];
+	double weight[NUM_CAMERAS];
+	std::fill(weight, weight + NUM_CAMERAS, 1.0);
+	for (int f = 0; f < numFrames; f++)
+	{
+		for (int g = 0; g < triangulator.numGroups; g++)
+		{
+			ViewMask views = 0;
+			for (ViewMask rest = triangulator.groupViews[g]; rest; rest &= rest - 1)
+			{
+				const int c = CountTrailingZeros(rest);
+				if (int(corners[c][f].size()) == numCorners)
+				{
+					const CameraModel& camera = rig.cameras[c];
+					cv::undistortPoints(corners[c][f], undistorted[c], cv::Mat(camera.K), cv::Mat(camera.distortion), cv::noArray(), cv::Mat(camera.K));
+					views |= ViewMask(1) << c;
+				}
+			}
+			if (CountViews(views) < 2)
+			{
+				continue;
+			}
+			for (int k = 0; k < numCorners; k++)
+			{
+				for (ViewMask rest = views; rest; rest &= rest - 1)
+				{
+					const int c = CountTrailingZeros(rest);
+					sensor[c] = cv::Point2d(undistorted[c][k].x, undistorted[c][k].y);
+				}
+				batch.Add(views, sensor, weight);
+				group.push_back(g);
+			}
+		}
+	}
+	BatchPoints points;
+	const int agreed = triangulator.TriangulateBatch(batch, points);
+	std::cout << "Triangulated " << batch.size() << " board corners, " << agreed << " with agreeing views" << std::endl;
+	for (int g = 0; g < triangulator.numGroups; g++)
+	{
+		double squared = 0;
+		int count = 0;
+		for (size_t k = 0; k < points.residual.size(); k++)
+		{
+			if (group[k] == g && points.inliers[k])
+			{
+				squared += points.residual[k] * points.residual[k];
+				count++;
+			}
+		}
+		if (count > 0)
+		{
+			std::cout << "Pair " << g << ": " << std::sqrt(squared / count) << " px RMS reprojection error over " << count << " corners" << std::endl;
+		}
+	}
+}
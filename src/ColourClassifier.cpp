@@ -0,0 +1,236 @@
+// 每个marker一个颜色类别，所有类别编译成一张查找表，分割时一次得到每个像素属于哪个marker
+#include "ColourClassifier.hpp"
+#include <iostream>
+
+
+ColourClassifier::ColourClassifier()
+{
+	Reset();
+}
+
+void ColourClassifier::Reset()
+{
+	classes.clear();
+	lut.assign(COLOUR_LUT_SIZE, 0);
+	sampleMarker = 0;
+	compiled = false;
+}
+
+// This function adds the pixels of an RGB image region to the samples of a marker
+void ColourClassifier::AddSamples(int marker_index, const cv::Mat& pixels)
+{
+	if (pixels.type() != CV_8UC3 || marker_index < 0 || marker_index > 253)
+	{
+		return;
+	}
+	if (int(classes.size()) <= marker_index)
+	{
+		Statistics empty = {};
+		classes.resize(marker_index + 1, empty);
+	}
+	Statistics& stats = classes[marker_index];
+	for (int y = 0; y < pixels.rows; y++)
+	{
+		const uchar* px = pixels.ptr<uchar>(y);
+		for (int x = 0; x < pixels.cols; x++, px += 3)
+		{
+			const double r = px[0], g = px[1], b = px[2];
+			stats.count += 1;
+			stats.sum[0] += r;
+			stats.sum[1] += g;
+			stats.sum[2] += b;
+			stats.cross[0] += r * r;
+			stats.cross[1] += r * g;
+			stats.cross[2] += r * b;
+			stats.cross[3] += g * g;
+			stats.cross[4] += g * b;
+			stats.cross[5] += b * b;
+		}
+	}
+}
+
+// whether every marker has enough samples for its class
+bool ColourClassifier::Sampled(int numMarkers) const
+{
+	if (int(classes.size()) < numMarkers)
+	{
+		return false;
+	}
+	for (int j = 0; j < numMarkers; j++)
+	{
+		if (classes[j].count < COLOUR_MIN_SAMPLES)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// This function fills the lookup table from the statistics of the classes.
+// Each cell is tested at the centre of the colours it stands for.
+bool ColourClassifier::Compile()
+{
+	struct Gaussian
+	{
+		int label;
+		double mean[3];
+		double inverse[6]; // symmetric, same order as Statistics::cross
+	};
+	std::vector<Gaussian> models;
+	for (size_t j = 0; j < classes.size(); j++)
+	{
+		const Statistics& stats = classes[j];
+		if (stats.count < COLOUR_MIN_SAMPLES)
+		{
+			continue;
+		}
+		Gaussian model;
+		model.label = int(j) + 1;
+		for (int c = 0; c < 3; c++)
+		{
+			model.mean[c] = stats.sum[c] / stats.count;
+		}
+		const double* m = model.mean;
+		double a = stats.cross[0] / stats.count - m[0] * m[0] + COLOUR_MIN_VARIANCE;
+		double b = stats.cross[1] / stats.count - m[0] * m[1];
+		double c = stats.cross[2] / stats.count - m[0] * m[2];
+		double d = stats.cross[3] / stats.count - m[1] * m[1] + COLOUR_MIN_VARIANCE;
+		double e = stats.cross[4] / stats.count - m[1] * m[2];
+		double f = stats.cross[5] / stats.count - m[2] * m[2] + COLOUR_MIN_VARIANCE;
+		// inverse of [a b c; b d e; c e f] by cofactors
+		double A = d * f - e * e, B = c * e - b * f, C = b * e - c * d;
+		double determinant = a * A + b * B + c * C;
+		if (determinant <= 0)
+		{
+			std::cout << "Colour samples of marker " << j << " are degenerate" << std::endl;
+			continue;
+		}
+		model.inverse[0] = A / determinant;
+		model.inverse[1] = B / determinant;
+		model.inverse[2] = C / determinant;
+		model.inverse[3] = (a * f - c * c) / determinant;
+		model.inverse[4] = (b * c - a * e) / determinant;
+		model.inverse[5] = (a * d - b * b) / determinant;
+		models.push_back(model);
+	}
+	compiled = false;
+	lut.assign(COLOUR_LUT_SIZE, 0);
+	if (models.empty())
+	{
+		return false;
+	}
+	const int levels = 1 << COLOUR_LUT_BITS;
+	const int step = 1 << (8 - COLOUR_LUT_BITS);
+	const double limit = COLOUR_MAX_DISTANCE * COLOUR_MAX_DISTANCE;
+	for (int r = 0; r < levels; r++)
+	{
+		for (int g = 0; g < levels; g++)
+		{
+			for (int b = 0; b < levels; b++)
+			{
+				const double colour[3] = { r * step + step * 0.5, g * step + step * 0.5, b * step + step * 0.5 };
+				double best = limit;
+				int label = 0;
+				for (size_t k = 0; k < models.size(); k++)
+				{
+					const Gaussian& model = models[k];
+					const double x = colour[0] - model.mean[0], y = colour[1] - model.mean[1], z = colour[2] - model.mean[2];
+					const double* q = model.inverse;
+					double distance = q[0] * x * x + q[3] * y * y + q[5] * z * z + 2 * (q[1] * x * y + q[2] * x * z + q[4] * y * z);
+					if (distance < best)
+					{
+						best = distance;
+						label = model.label;
+					}
+				}
+				lut[(r << (2 * COLOUR_LUT_BITS)) | (g << COLOUR_LUT_BITS) | b] = uchar(label);
+			}
+		}
+	}
+	compiled = true;
+	std::cout << "Colour classes compiled for " << models.size() << " markers" << std::endl;
+	return true;
+}
+
+// This function reads the sample statistics of a file written by Save and compiles them
+bool ColourClassifier::Load(const std::string& path)
+{
+	cv::FileStorage fs;
+	try
+	{
+		if (!fs.open(path, cv::FileStorage::READ))
+		{
+			std::cout << "Colour classes " << path << " can not be opened" << std::endl;
+			return false;
+		}
+		cv::FileNode node = fs["classes"];
+		if (!node.isSeq())
+		{
+			std::cout << "Colour classes " << path << " has no class list" << std::endl;
+			return false;
+		}
+		Reset();
+		for (int k = 0; k < int(node.size()); k++)
+		{
+			cv::FileNode entry = node[k];
+			int marker_index = int(entry["marker"]);
+			if (marker_index < 0 || marker_index > 253)
+			{
+				continue;
+			}
+			if (int(classes.size()) <= marker_index)
+			{
+				Statistics empty = {};
+				classes.resize(marker_index + 1, empty);
+			}
+			Statistics& stats = classes[marker_index];
+			stats.count = double(entry["count"]);
+			for (int c = 0; c < 3; c++)
+			{
+				stats.sum[c] = double(entry["sum"][c]);
+			}
+			for (int c = 0; c < 6; c++)
+			{
+				stats.cross[c] = double(entry["cross"][c]);
+			}
+		}
+	}
+	catch (cv::Exception& e)
+	{
+		std::cout << "OpenCV Error: while reading colour classes " << path << ": \n" << e.what() << std::endl;
+		return false;
+	}
+	return Compile();
+}
+
+bool ColourClassifier::Save(const std::string& path) const
+{
+	try
+	{
+		cv::FileStorage fs(path, cv::FileStorage::WRITE);
+		if (!fs.isOpened())
+		{
+			std::cout << "Colour classes " << path << " can not be written" << std::endl;
+			return false;
+		}
+		fs << "classes" << "[";
+		for (size_t j = 0; j < classes.size(); j++)
+		{
+			const Statistics& stats = classes[j];
+			if (stats.count == 0)
+			{
+				continue;
+			}
+			fs << "{" << "marker" << int(j) << "count" << stats.count
+				<< "sum" << std::vector<double>(stats.sum, stats.sum + 3)
+				<< "cross" << std::vector<double>(stats.cross, stats.cross + 6) << "}";
+		}
+		fs << "]";
+	}
+	catch (cv::Exception& e)
+	{
+		std::cout << "OpenCV Error: while writing colour classes " << path << ": \n" << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,233 @@
+// 步态数据在后台线程中按块写入CSV文件，跟踪线程只复制数据
+#include "GaitExporter.h"
+#include <algorithm>
+#include <iostream>
+
+const int GAIT_VALUE_CHARS = 24; // room for one formatted value and its separator
+
+
+GaitExporter::GaitExporter() :running(false), submitted(0), written(0), filled(0), frames(0), dropped(0), numMarkers(0), file(nullptr), format(GaitCsv), recorded(0), firstTime(0), lastTime(0)
+{
+	records.resize(size_t(GAIT_BLOCKS) * GAIT_BLOCK_RECORDS);
+}
+
+
+GaitExporter::~GaitExporter()
+{
+	Close();
+}
+
+static bool EndsWith(const std::string& path, const std::string& extension)
+{
+	return path.size() > extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// This function creates the file, writes the column names, the C3D header or the store header and starts the writer.
+// CSV columns are time and frame, then x, y, z of every marker and the hip, knee and ankle angle of each leg.
+bool GaitExporter::Open(const std::string& path, const std::vector<std::string>& markerNames)
+{
+	Close();
+	if (markerNames.empty() || int(markerNames.size()) > MAX_MARKERS)
+	{
+		std::cout << "Gait data needs 1 to " << MAX_MARKERS << " markers, " << markerNames.size() << " given" << std::endl;
+		return false;
+	}
+	file = std::fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "Gait data file " << path << " can not be created" << std::endl;
+		return false;
+	}
+	// the writer hands over whole blocks, stdio buffering would only copy them once more
+	std::setvbuf(file, nullptr, _IONBF, 0);
+	names = markerNames;
+	numMarkers = int(names.size());
+	format = EndsWith(path, ".c3d") ? GaitC3d : (EndsWith(path, ".gaitcol") ? GaitColumns : GaitCsv);
+	const bool begun = format == GaitC3d ? c3d.Begin(file, names) : (format == GaitColumns ? store.Begin(file, names) : WriteHeader());
+	if (!begun)
+	{
+		std::fclose(file);
+		file = nullptr;
+		return false;
+	}
+	// the column store collects its chunks itself
+	const size_t recordSize = format == GaitC3d ? c3d.FrameSize() : (format == GaitColumns ? 0 : (2 + GAIT_PAIRS * (3 * numMarkers + 3)) * GAIT_VALUE_CHARS);
+	text.resize(size_t(GAIT_BLOCK_RECORDS) * recordSize);
+	recorded = 0;
+	submitted = written = 0;
+	filled = frames = 0;
+	dropped = 0;
+	running = true;
+	worker = std::thread(&GaitExporter::Run, this);
+	return true;
+}
+
+// This function hands the records still in the current block to the writer, waits until everything is on disk and closes the file
+void GaitExporter::Close()
+{
+	if (!file)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (filled > 0)
+		{
+			counts[submitted % GAIT_BLOCKS] = filled;
+			submitted++;
+			filled = 0;
+		}
+		running = false;
+	}
+	wake.notify_one();
+	worker.join();
+	if (format == GaitC3d)
+	{
+		c3d.End(file, recorded, firstTime, lastTime);
+	}
+	else if (format == GaitColumns)
+	{
+		store.End(file);
+	}
+	std::fclose(file);
+	file = nullptr;
+	if (dropped > 0)
+	{
+		std::cout << "Gait data: " << dropped << " of " << frames << " frames were dropped, the disk did not keep up" << std::endl;
+	}
+}
+
+// This function copies one frame into the current block, it is called by the frame loop.
+// It only takes the lock when a block changes hands and returns false if the frame was dropped.
+bool GaitExporter::Append(double time, const Vec3 markers[][MAX_MARKERS], const double residual[][MAX_MARKERS], const ViewMask used[][MAX_MARKERS],
+	const double hip[], const double knee[], const double ankle[])
+{
+	if (!file)
+	{
+		return false;
+	}
+	const int block = int(submitted % GAIT_BLOCKS);
+	if (filled == 0)
+	{
+		// the block is free once the writer is done with its last use, GAIT_BLOCKS submissions ago
+		std::lock_guard<std::mutex> guard(lock);
+		if (submitted - written >= GAIT_BLOCKS)
+		{
+			dropped++;
+			frames++;
+			return false;
+		}
+	}
+	GaitRecord& record = records[size_t(block) * GAIT_BLOCK_RECORDS + filled];
+	record.time = time;
+	record.frame = frames++;
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		std::copy(markers[i], markers[i] + numMarkers, record.markers[i]);
+		std::copy(residual[i], residual[i] + numMarkers, record.residual[i]);
+		std::copy(used[i], used[i] + numMarkers, record.used[i]);
+		record.hip[i] = hip[i];
+		record.knee[i] = knee[i];
+		record.ankle[i] = ankle[i];
+	}
+	if (++filled == GAIT_BLOCK_RECORDS)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			counts[block] = filled;
+			submitted++;
+		}
+		wake.notify_one();
+		filled = 0;
+	}
+	return true;
+}
+
+void GaitExporter::Run()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (running || written < submitted)
+	{
+		wake.wait(guard, [this]() { return !running || written < submitted; });
+		if (written == submitted)
+		{
+			continue;
+		}
+		const int block = int(written % GAIT_BLOCKS);
+		const int count = counts[block];
+		guard.unlock();
+		WriteBlock(block, count);
+		guard.lock();
+		written++;
+	}
+}
+
+bool GaitExporter::WriteHeader()
+{
+	std::string header = "time,frame";
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		for (int j = 0; j < numMarkers; j++)
+		{
+			const std::string column = std::string(",") + LegName(i) + "_" + names[j];
+			header += column + "_x" + column + "_y" + column + "_z";
+		}
+	}
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		header += std::string(",") + LegName(i) + "_hip," + LegName(i) + "_knee," + LegName(i) + "_ankle";
+	}
+	header += "\n";
+	return std::fwrite(header.data(), 1, header.size(), file) == header.size();
+}
+
+// This function formats the records of a block into one buffer and writes it at once.
+// Positions are in millimetre, angles in degree. %g keeps every value within GAIT_VALUE_CHARS whatever its magnitude.
+bool GaitExporter::WriteBlock(int block, int count)
+{
+	if (format == GaitColumns)
+	{
+		bool success = true;
+		for (int r = 0; r < count; r++)
+		{
+			success = store.Add(file, records[size_t(block) * GAIT_BLOCK_RECORDS + r]) && success;
+		}
+		return success;
+	}
+	char* out = text.data();
+	for (int r = 0; r < count; r++)
+	{
+		const GaitRecord& record = records[size_t(block) * GAIT_BLOCK_RECORDS + r];
+		if (recorded++ == 0)
+		{
+			firstTime = record.time;
+		}
+		lastTime = record.time;
+		if (format == GaitC3d)
+		{
+			out = c3d.EncodeFrame(record, out);
+			continue;
+		}
+		out += std::sprintf(out, "%.10g,%d", record.time, record.frame);
+		for (int i = 0; i < GAIT_PAIRS; i++)
+		{
+			for (int j = 0; j < numMarkers; j++)
+			{
+				const Vec3& p = record.markers[i][j];
+				out += std::sprintf(out, ",%.9g,%.9g,%.9g", p.x, p.y, p.z);
+			}
+		}
+		for (int i = 0; i < GAIT_PAIRS; i++)
+		{
+			out += std::sprintf(out, ",%.6g,%.6g,%.6g", record.hip[i], record.knee[i], record.ankle[i]);
+		}
+		*out++ = '\n';
+	}
+	const size_t length = size_t(out - text.data());
+	if (std::fwrite(text.data(), 1, length, file) != length)
+	{
+		std::cout << "Gait data: writing " << count << " frames failed" << std::endl;
+		return false;
+	}
+	return true;
+}
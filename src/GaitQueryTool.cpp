@@ -0,0 +1,57 @@
+// 查询工具：在多个步态会话中找出某一列落在给定范围内的所有帧
+#include "GaitStore.h"
+#include <cstdlib>
+#include <iostream>
+
+
+// GaitQuery <column> <low> <high> <session.gaitcol>... [--list]
+// e.g. GaitQuery left_knee 60 180 sessions/*.gaitcol finds the frames with more than 60 deg of left knee flexion.
+// --list prints every matching frame as session, frame, time, value instead of the counts per session
+int main(int argc, char** argv)
+{
+	if (argc < 5)
+	{
+		std::cout << "Usage: " << argv[0] << " <column, e.g. left_knee> <low> <high> <session.gaitcol>... [--list]" << std::endl;
+		return -1;
+	}
+	const std::string column = argv[1];
+	const double low = std::atof(argv[2]), high = std::atof(argv[3]);
+	bool list = false;
+	GaitCohort cohort;
+	for (int k = 4; k < argc; k++)
+	{
+		std::string argument(argv[k]);
+		if (argument == "--list")
+		{
+			list = true;
+		}
+		else if (!cohort.Add(argument))
+		{
+			std::cout << "Skipping " << argument << std::endl;
+		}
+	}
+	std::vector<GaitMatch> matches;
+	const int read = cohort.Query(column, low, high, matches);
+	if (list)
+	{
+		for (size_t m = 0; m < matches.size(); m++)
+		{
+			std::cout << cohort.sessions[matches[m].session].path << "," << matches[m].frame << "," << matches[m].time << "," << matches[m].value << std::endl;
+		}
+	}
+	else
+	{
+		std::vector<int> counts(cohort.sessions.size(), 0);
+		for (size_t m = 0; m < matches.size(); m++)
+		{
+			counts[matches[m].session]++;
+		}
+		for (size_t s = 0; s < cohort.sessions.size(); s++)
+		{
+			std::cout << cohort.sessions[s].path << ": " << counts[s] << " of " << cohort.sessions[s].numFrames << " frames" << std::endl;
+		}
+	}
+	std::cout << matches.size() << " frames match " << column << " in [" << low << ", " << high << "], "
+		<< read << " of " << cohort.NumChunks() << " chunks read" << std::endl;
+	return 0;
+}
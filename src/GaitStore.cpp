@@ -0,0 +1,398 @@
+// 按列存储每帧的输出，每块带最小值和最大值，查询时跳过不可能满足条件的块
+#include "GaitStore.h"
+#include "GaitRecord.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+static const char GAIT_STORE_MAGIC[8] = { 'G', 'A', 'I', 'T', 'C', 'O', 'L', '1' };
+const uint32_t GAIT_STORE_VERSION = 1;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static size_t TypeWidth(int type)
+{
+	return type == GaitFloat64 ? sizeof(double) : sizeof(float);
+}
+
+
+GaitStoreWriter::GaitStoreWriter() :numMarkers(0), chunkSize(0), rows(0), numChunks(0), numFrames(0), dataOffset(0)
+{
+}
+
+void GaitStoreWriter::AddColumn(const std::string& name, GaitColumnType type)
+{
+	GaitColumnRecord column;
+	std::memset(&column, 0, sizeof(column));
+	name.copy(column.name, GAIT_COLUMN_NAME - 1);
+	column.type = type;
+	column.width = uint32_t(TypeWidth(type));
+	column.offset = chunkSize;
+	chunkSize += size_t(column.width) * GAIT_STORE_CHUNK;
+	columns.push_back(column);
+}
+
+// This function lays out the columns and writes a header without chunks, the frames follow from dataOffset on
+bool GaitStoreWriter::Begin(std::FILE* file, const std::vector<std::string>& markerNames)
+{
+	numMarkers = int(markerNames.size());
+	columns.clear();
+	chunkSize = 0;
+	AddColumn("time", GaitFloat64);
+	AddColumn("frame", GaitUInt32);
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		for (int j = 0; j < numMarkers; j++)
+		{
+			const std::string marker = std::string(LegName(i)) + "_" + markerNames[j];
+			if (marker.size() + 10 >= size_t(GAIT_COLUMN_NAME))
+			{
+				std::cout << "Gait store: marker name " << markerNames[j] << " is too long for a column name" << std::endl;
+				return false;
+			}
+			AddColumn(marker + "_x", GaitFloat32);
+			AddColumn(marker + "_y", GaitFloat32);
+			AddColumn(marker + "_z", GaitFloat32);
+			AddColumn(marker + "_residual", GaitFloat32);
+			AddColumn(marker + "_cameras", GaitUInt32);
+		}
+	}
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		AddColumn(std::string(LegName(i)) + "_hip", GaitFloat32);
+		AddColumn(std::string(LegName(i)) + "_knee", GaitFloat32);
+		AddColumn(std::string(LegName(i)) + "_ankle", GaitFloat32);
+	}
+	chunkSize = size_t(AlignUp(chunkSize, GAIT_STORE_ALIGN));
+	chunk.assign(chunkSize, 0);
+	rows = 0;
+	minimum.assign(columns.size(), std::numeric_limits<double>::infinity());
+	maximum.assign(columns.size(), -std::numeric_limits<double>::infinity());
+	summaries.clear();
+	numChunks = 0;
+	numFrames = 0;
+	dataOffset = AlignUp(sizeof(GaitStoreHeader) + columns.size() * sizeof(GaitColumnRecord), GAIT_STORE_ALIGN);
+
+	GaitStoreHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, GAIT_STORE_MAGIC, sizeof(header.magic));
+	std::vector<char> start(size_t(dataOffset), 0);
+	std::memcpy(&start[0], &header, sizeof(header));
+	std::memcpy(&start[sizeof(header)], &columns[0], columns.size() * sizeof(GaitColumnRecord));
+	if (std::fwrite(start.data(), 1, start.size(), file) != start.size())
+	{
+		std::cout << "Gait store: writing the header failed" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// This function puts a value into the current row of a column, the summary sees the value as it is stored
+void GaitStoreWriter::Store(int column, double value)
+{
+	char* at = &chunk[size_t(columns[column].offset) + size_t(rows) * columns[column].width];
+	switch (columns[column].type)
+	{
+	case GaitFloat64:
+		std::memcpy(at, &value, sizeof(value));
+		break;
+	case GaitUInt32:
+	{
+		const uint32_t stored = uint32_t(value);
+		std::memcpy(at, &stored, sizeof(stored));
+		value = stored;
+		break;
+	}
+	default:
+	{
+		const float stored = float(value);
+		std::memcpy(at, &stored, sizeof(stored));
+		value = stored;
+		break;
+	}
+	}
+	if (value == value)
+	{
+		minimum[column] = std::min(minimum[column], value);
+		maximum[column] = std::max(maximum[column], value);
+	}
+}
+
+bool GaitStoreWriter::Add(std::FILE* file, const GaitRecord& record)
+{
+	int column = 0;
+	Store(column++, record.time);
+	Store(column++, record.frame);
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		for (int j = 0; j < numMarkers; j++)
+		{
+			Store(column++, record.markers[i][j].x);
+			Store(column++, record.markers[i][j].y);
+			Store(column++, record.markers[i][j].z);
+			Store(column++, record.residual[i][j]);
+			Store(column++, record.used[i][j]);
+		}
+	}
+	for (int i = 0; i < GAIT_PAIRS; i++)
+	{
+		Store(column++, record.hip[i]);
+		Store(column++, record.knee[i]);
+		Store(column++, record.ankle[i]);
+	}
+	numFrames++;
+	return ++rows < GAIT_STORE_CHUNK || WriteChunk(file);
+}
+
+// This function writes the chunk, padded to its full size, and keeps its summary
+bool GaitStoreWriter::WriteChunk(std::FILE* file)
+{
+	if (rows == 0)
+	{
+		return true;
+	}
+	const bool written = std::fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+	summaries.insert(summaries.end(), minimum.begin(), minimum.end());
+	summaries.insert(summaries.end(), maximum.begin(), maximum.end());
+	std::fill(minimum.begin(), minimum.end(), std::numeric_limits<double>::infinity());
+	std::fill(maximum.begin(), maximum.end(), -std::numeric_limits<double>::infinity());
+	std::fill(chunk.begin(), chunk.end(), 0);
+	rows = 0;
+	numChunks++;
+	if (!written)
+	{
+		std::cout << "Gait store: writing a chunk failed" << std::endl;
+	}
+	return written;
+}
+
+// This function writes the last chunk and the summaries, then the header with the final counts
+bool GaitStoreWriter::End(std::FILE* file)
+{
+	bool success = WriteChunk(file);
+	GaitStoreHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, GAIT_STORE_MAGIC, sizeof(header.magic));
+	header.version = GAIT_STORE_VERSION;
+	header.chunkFrames = GAIT_STORE_CHUNK;
+	header.numColumns = uint32_t(columns.size());
+	header.numChunks = numChunks;
+	header.numFrames = numFrames;
+	header.chunkSize = chunkSize;
+	header.dataOffset = dataOffset;
+	header.indexOffset = dataOffset + uint64_t(numChunks) * chunkSize;
+	std::fseek(file, 0, SEEK_END);
+	if (!summaries.empty())
+	{
+		success = std::fwrite(summaries.data(), sizeof(double), summaries.size(), file) == summaries.size() && success;
+	}
+	std::fseek(file, 0, SEEK_SET);
+	success = std::fwrite(&header, sizeof(header), 1, file) == 1 && success;
+	std::fflush(file);
+	if (!success)
+	{
+		std::cout << "Gait store: closing the session failed" << std::endl;
+	}
+	return success;
+}
+
+
+GaitSession::GaitSession() :numFrames(0), numColumns(0), numChunks(0), header(NULL), columns(NULL), summaries(NULL)
+{
+}
+
+void GaitSession::Close()
+{
+	file.Close();
+	header = NULL;
+	columns = NULL;
+	summaries = NULL;
+	numFrames = numColumns = numChunks = 0;
+}
+
+// This function maps a session and checks that header, columns, chunks and summaries lie inside the file
+bool GaitSession::Open(const std::string& path_)
+{
+	Close();
+	path = path_;
+	if (!file.Open(path) || file.size < sizeof(GaitStoreHeader))
+	{
+		std::cout << "Gait session " << path << " can not be opened" << std::endl;
+		Close();
+		return false;
+	}
+	header = reinterpret_cast<const GaitStoreHeader*>(file.data);
+	if (std::memcmp(header->magic, GAIT_STORE_MAGIC, sizeof(header->magic)) != 0 || header->version != GAIT_STORE_VERSION)
+	{
+		std::cout << "Gait session " << path << " is no closed session of the gait store" << std::endl;
+		Close();
+		return false;
+	}
+	const uint64_t columnsEnd = sizeof(GaitStoreHeader) + uint64_t(header->numColumns) * sizeof(GaitColumnRecord);
+	const uint64_t summariesSize = uint64_t(header->numChunks) * 2 * header->numColumns * sizeof(double);
+	if (header->numColumns == 0 || columnsEnd > header->dataOffset || header->chunkFrames == 0 ||
+		header->numFrames > uint64_t(header->numChunks) * header->chunkFrames || header->chunkSize % GAIT_STORE_ALIGN != 0 ||
+		header->dataOffset % GAIT_STORE_ALIGN != 0 || header->indexOffset != header->dataOffset + uint64_t(header->numChunks) * header->chunkSize ||
+		header->indexOffset + summariesSize > file.size)
+	{
+		std::cout << "Gait session " << path << " is damaged" << std::endl;
+		Close();
+		return false;
+	}
+	columns = reinterpret_cast<const GaitColumnRecord*>(file.data + sizeof(GaitStoreHeader));
+	for (uint32_t c = 0; c < header->numColumns; c++)
+	{
+		if (columns[c].width != TypeWidth(columns[c].type) || columns[c].offset + uint64_t(columns[c].width) * header->chunkFrames > header->chunkSize)
+		{
+			std::cout << "Gait session " << path << " is damaged" << std::endl;
+			Close();
+			return false;
+		}
+	}
+	summaries = reinterpret_cast<const double*>(file.data + header->indexOffset);
+	numFrames = int(header->numFrames);
+	numColumns = int(header->numColumns);
+	numChunks = int(header->numChunks);
+	return true;
+}
+
+// index of the column with the given name, -1 if the session has no such column
+int GaitSession::Column(const std::string& name) const
+{
+	for (int c = 0; c < numColumns; c++)
+	{
+		if (name.compare(0, std::string::npos, columns[c].name, strnlen(columns[c].name, GAIT_COLUMN_NAME)) == 0)
+		{
+			return c;
+		}
+	}
+	return -1;
+}
+
+int GaitSession::ChunkFrames(int chunk) const
+{
+	return std::min(int(header->chunkFrames), numFrames - chunk * int(header->chunkFrames));
+}
+
+const uint8_t* GaitSession::ColumnData(int column, int chunk) const
+{
+	return file.data + header->dataOffset + uint64_t(chunk) * header->chunkSize + columns[column].offset;
+}
+
+double GaitSession::Value(int column, int frame) const
+{
+	const int chunk = frame / int(header->chunkFrames);
+	const uint8_t* at = ColumnData(column, chunk) + size_t(frame % header->chunkFrames) * columns[column].width;
+	switch (columns[column].type)
+	{
+	case GaitFloat64: return *reinterpret_cast<const double*>(at);
+	case GaitUInt32: return *reinterpret_cast<const uint32_t*>(at);
+	default: return *reinterpret_cast<const float*>(at);
+	}
+}
+
+// This function returns the first frame at or after time, numFrames if there is none.
+// The chunk is found on the time summaries, the frame by bisection of the chunk's time column.
+int GaitSession::FindFrame(double time) const
+{
+	int low = 0, high = numChunks;
+	while (low < high)
+	{
+		const int middle = (low + high) / 2;
+		if (Maximum(middle)[0] < time)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	if (low == numChunks)
+	{
+		return numFrames;
+	}
+	const double* times = reinterpret_cast<const double*>(ColumnData(0, low));
+	return low * int(header->chunkFrames) + int(std::lower_bound(times, times + ChunkFrames(low), time) - times);
+}
+
+template<class T>
+static void Scan(const T* values, int count, double low, double high, int firstFrame, const double* times, int session, std::vector<GaitMatch>& matches)
+{
+	for (int k = 0; k < count; k++)
+	{
+		const double value = values[k];
+		if (value >= low && value <= high)
+		{
+			GaitMatch match = { session, firstFrame + k, times[k], value };
+			matches.push_back(match);
+		}
+	}
+}
+
+// This function adds the frames whose value of column lies in [low, high] to matches and returns the number of chunks read.
+// Chunks whose summary lies outside the range are skipped without touching their pages.
+int GaitSession::Query(int column, double low, double high, int session, std::vector<GaitMatch>& matches) const
+{
+	int read = 0;
+	for (int k = 0; k < numChunks; k++)
+	{
+		if (Maximum(k)[column] < low || Minimum(k)[column] > high)
+		{
+			continue;
+		}
+		read++;
+		const uint8_t* values = ColumnData(column, k);
+		const double* times = reinterpret_cast<const double*>(ColumnData(0, k));
+		const int first = k * int(header->chunkFrames), count = ChunkFrames(k);
+		switch (columns[column].type)
+		{
+		case GaitFloat64: Scan(reinterpret_cast<const double*>(values), count, low, high, first, times, session, matches); break;
+		case GaitUInt32: Scan(reinterpret_cast<const uint32_t*>(values), count, low, high, first, times, session, matches); break;
+		default: Scan(reinterpret_cast<const float*>(values), count, low, high, first, times, session, matches); break;
+		}
+	}
+	return read;
+}
+
+
+bool GaitCohort::Add(const std::string& path)
+{
+	sessions.emplace_back();
+	if (!sessions.back().Open(path))
+	{
+		sessions.pop_back();
+		return false;
+	}
+	return true;
+}
+
+// This function queries the column in every session that has it and returns the number of chunks read.
+// GaitMatch::session is the index of the session in sessions.
+int GaitCohort::Query(const std::string& column, double low, double high, std::vector<GaitMatch>& matches) const
+{
+	int read = 0;
+	for (size_t s = 0; s < sessions.size(); s++)
+	{
+		const int c = sessions[s].Column(column);
+		if (c >= 0)
+		{
+			read += sessions[s].Query(c, low, high, int(s), matches);
+		}
+	}
+	return read;
+}
+
+int GaitCohort::NumChunks() const
+{
+	int chunks = 0;
+	for (size_t s = 0; s < sessions.size(); s++)
+	{
+		chunks += sessions[s].numChunks;
+	}
+	return chunks;
+}
@@ -0,0 +1,76 @@
+// 只对marker的中心点做镜头畸变校正：启动时计算粗网格上的校正值，每帧对点做双线性插值
+#include "LensCorrection.h"
+#include <algorithm>
+
+
+LensCorrection::LensCorrection() :cols(0), rows(0)
+{
+}
+
+// This function computes the grid of a camera for images of the given size, it takes a few milliseconds
+void LensCorrection::Build(const CameraModel& camera, const cv::Size& imageSize_)
+{
+	imageSize = imageSize_;
+	cols = (imageSize.width + LENS_GRID_STEP - 1) / LENS_GRID_STEP + 1;
+	rows = (imageSize.height + LENS_GRID_STEP - 1) / LENS_GRID_STEP + 1;
+	std::vector<cv::Point2d> distorted(size_t(cols) * rows), undistorted;
+	for (int gy = 0; gy < rows; gy++)
+	{
+		for (int gx = 0; gx < cols; gx++)
+		{
+			distorted[size_t(gy) * cols + gx] = camera.ToSensor(cv::Point2d(gx * LENS_GRID_STEP, gy * LENS_GRID_STEP));
+		}
+	}
+	const cv::Mat K(camera.K), distortion(camera.distortion);
+	cv::undistortPoints(distorted, undistorted, K, distortion, cv::noArray(), K);
+	// undistortPoints stops after a few fixed-point steps, which leaves tenths of a pixel near the image corners,
+	// so the nodes are moved on until the forward model maps them onto the grid
+	std::vector<cv::Point3d> rays(undistorted.size());
+	std::vector<cv::Point2d> projected;
+	const cv::Matx33d Kinv = camera.K.inv();
+	for (int iteration = 0; iteration < LENS_REFINE_ITERATIONS; iteration++)
+	{
+		for (size_t k = 0; k < undistorted.size(); k++)
+		{
+			cv::Vec3d ray = Kinv * cv::Vec3d(undistorted[k].x, undistorted[k].y, 1);
+			rays[k] = cv::Point3d(ray[0] / ray[2], ray[1] / ray[2], 1);
+		}
+		cv::projectPoints(rays, cv::Vec3d(0, 0, 0), cv::Vec3d(0, 0, 0), K, distortion, projected);
+		for (size_t k = 0; k < undistorted.size(); k++)
+		{
+			undistorted[k] += distorted[k] - projected[k];
+		}
+	}
+	nodeX.resize(undistorted.size());
+	nodeY.resize(undistorted.size());
+	for (size_t k = 0; k < undistorted.size(); k++)
+	{
+		nodeX[k] = undistorted[k].x;
+		nodeY[k] = undistorted[k].y;
+	}
+}
+
+// This function corrects one image point into undistorted sensor coordinates.
+// Points outside the image are extrapolated from the border cells.
+cv::Point2d LensCorrection::Correct(const cv::Point2d& image) const
+{
+	const double fx = image.x * (1.0 / LENS_GRID_STEP), fy = image.y * (1.0 / LENS_GRID_STEP);
+	const int gx = std::min(std::max(int(fx), 0), cols - 2);
+	const int gy = std::min(std::max(int(fy), 0), rows - 2);
+	const double ax = fx - gx, ay = fy - gy;
+	const size_t i = size_t(gy) * cols + gx;
+	const double top = nodeX[i] + ax * (nodeX[i + 1] - nodeX[i]);
+	const double bottom = nodeX[i + cols] + ax * (nodeX[i + cols + 1] - nodeX[i + cols]);
+	const double left = nodeY[i] + ay * (nodeY[i + cols] - nodeY[i]);
+	const double right = nodeY[i + 1] + ay * (nodeY[i + cols + 1] - nodeY[i + 1]);
+	return cv::Point2d(top + ay * (bottom - top), left + ax * (right - left));
+}
+
+// This function corrects the centroids of one camera in one call
+void LensCorrection::Correct(const cv::Point image[], int count, cv::Point2d sensor[]) const
+{
+	for (int k = 0; k < count; k++)
+	{
+		sensor[k] = Correct(cv::Point2d(image[k].x, image[k].y));
+	}
+}
@@ -0,0 +1,92 @@
+// 把整个文件只读映射到内存
+#include "MappedFile.h"
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile() :data(NULL), size(0),
+#if defined(_WIN32)
+	file(INVALID_HANDLE_VALUE), mapping(NULL)
+#else
+	file(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+	if (data)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file);
+	}
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data)
+	{
+		munmap((void*)data, size);
+	}
+	if (file >= 0)
+	{
+		close(file);
+	}
+	file = -1;
+#endif
+	data = NULL;
+	size = 0;
+}
+
+// This function returns false when the file can not be opened, is empty or can not be mapped
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+#if defined(_WIN32)
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER length;
+	if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &length) || length.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	size = size_t(length.QuadPart);
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	data = mapping ? (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+	file = open(path.c_str(), O_RDONLY);
+	struct stat status;
+	if (file < 0 || fstat(file, &status) != 0 || status.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	size = size_t(status.st_size);
+	void* view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+	data = view == MAP_FAILED ? NULL : (const uint8_t*)view;
+#endif
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
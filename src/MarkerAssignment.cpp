@@ -0,0 +1,207 @@
+// 用匈牙利算法把检测到的点分配给marker，只在门限内相连的点和marker之间求解
+#include "MarkerAssignment.hpp"
+#include <limits>
+
+const double FORBIDDEN_COST = 1e6; // a detection outside the gate of the marker
+
+int MarkerAssignment::Find(int node)
+{
+	while (parent[node] != node)
+	{
+		parent[node] = parent[parent[node]];
+		node = parent[node];
+	}
+	return node;
+}
+
+// This function sets match[marker] to the detection assigned to the marker, or -1.
+// Markers are nodes 0 ... numMarkers - 1, detection k is node numMarkers + k.
+void MarkerAssignment::Solve(int numMarkers, int numDetections, const std::vector<AssignmentEdge>& edges, std::vector<int>& match)
+{
+	match.assign(numMarkers, -1);
+	const int numNodes = numMarkers + numDetections;
+	parent.resize(numNodes);
+	for (int k = 0; k < numNodes; k++)
+	{
+		parent[k] = k;
+	}
+	for (size_t e = 0; e < edges.size(); e++)
+	{
+		int a = Find(edges[e].marker), b = Find(numMarkers + edges[e].detection);
+		if (a != b)
+		{
+			parent[a] = b;
+		}
+	}
+	// group the nodes and edges by component
+	componentOf.assign(numNodes, -1);
+	int numComponents = 0;
+	for (size_t e = 0; e < edges.size(); e++)
+	{
+		int root = Find(edges[e].marker);
+		if (componentOf[root] < 0)
+		{
+			componentOf[root] = numComponents++;
+		}
+	}
+	if (int(componentEdges.size()) < numComponents)
+	{
+		componentMarkers.resize(numComponents);
+		componentDetections.resize(numComponents);
+		componentEdges.resize(numComponents);
+	}
+	for (int c = 0; c < numComponents; c++)
+	{
+		componentMarkers[c].clear();
+		componentDetections[c].clear();
+		componentEdges[c].clear();
+	}
+	for (int k = 0; k < numNodes; k++)
+	{
+		int c = componentOf[Find(k)];
+		if (c < 0)
+		{
+			continue; // a marker or a detection without any edge
+		}
+		if (k < numMarkers)
+		{
+			componentMarkers[c].push_back(k);
+		}
+		else
+		{
+			componentDetections[c].push_back(k - numMarkers);
+		}
+	}
+	for (size_t e = 0; e < edges.size(); e++)
+	{
+		componentEdges[componentOf[Find(edges[e].marker)]].push_back(int(e));
+	}
+
+	for (int c = 0; c < numComponents; c++)
+	{
+		if (componentMarkers[c].size() == 1)
+		{
+			// a lone marker takes its closest detection, every edge lies inside the gate
+			int best = -1;
+			for (size_t k = 0; k < componentEdges[c].size(); k++)
+			{
+				int e = componentEdges[c][k];
+				if (best < 0 || edges[e].cost < edges[best].cost)
+				{
+					best = e;
+				}
+			}
+			match[edges[best].marker] = edges[best].detection;
+		}
+		else
+		{
+			// localIndex maps the nodes of the component to rows and columns
+			localIndex.resize(numNodes);
+			for (size_t k = 0; k < componentMarkers[c].size(); k++)
+			{
+				localIndex[componentMarkers[c][k]] = int(k);
+			}
+			for (size_t k = 0; k < componentDetections[c].size(); k++)
+			{
+				localIndex[numMarkers + componentDetections[c][k]] = int(k);
+			}
+			std::vector<AssignmentEdge> local;
+			local.reserve(componentEdges[c].size());
+			for (size_t k = 0; k < componentEdges[c].size(); k++)
+			{
+				const AssignmentEdge& edge = edges[componentEdges[c][k]];
+				AssignmentEdge mapped = { localIndex[edge.marker], localIndex[numMarkers + edge.detection], edge.cost };
+				local.push_back(mapped);
+			}
+			SolveComponent(componentMarkers[c], componentDetections[c], local, match);
+		}
+	}
+}
+
+// This function solves one component with the O(n^2 m) Hungarian method with potentials.
+// Rows are the n markers, columns are the detections followed by n dummy columns of cost 1,
+// a marker that ends on a dummy column stays unassigned.
+void MarkerAssignment::SolveComponent(const std::vector<int>& markers, const std::vector<int>& detections, const std::vector<AssignmentEdge>& edges, std::vector<int>& match)
+{
+	const int n = int(markers.size());
+	const int d = int(detections.size());
+	const int m = d + n;
+	// 1-based cost matrix, row 0 and column 0 are unused
+	cost.assign(size_t(n + 1) * (m + 1), FORBIDDEN_COST);
+	for (int i = 1; i <= n; i++)
+	{
+		for (int j = d + 1; j <= m; j++)
+		{
+			cost[size_t(i) * (m + 1) + j] = 1.0;
+		}
+	}
+	for (size_t e = 0; e < edges.size(); e++)
+	{
+		cost[size_t(edges[e].marker + 1) * (m + 1) + edges[e].detection + 1] = edges[e].cost;
+	}
+
+	const double inf = std::numeric_limits<double>::max();
+	u.assign(n + 1, 0);
+	v.assign(m + 1, 0);
+	p.assign(m + 1, 0);
+	way.assign(m + 1, 0);
+	for (int i = 1; i <= n; i++)
+	{
+		p[0] = i;
+		int j0 = 0;
+		minv.assign(m + 1, inf);
+		used.assign(m + 1, false);
+		do
+		{
+			used[j0] = true;
+			int i0 = p[j0], j1 = 0;
+			double delta = inf;
+			for (int j = 1; j <= m; j++)
+			{
+				if (used[j])
+				{
+					continue;
+				}
+				double reduced = cost[size_t(i0) * (m + 1) + j] - u[i0] - v[j];
+				if (reduced < minv[j])
+				{
+					minv[j] = reduced;
+					way[j] = j0;
+				}
+				if (minv[j] < delta)
+				{
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (int j = 0; j <= m; j++)
+			{
+				if (used[j])
+				{
+					u[p[j]] += delta;
+					v[j] -= delta;
+				}
+				else
+				{
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (p[j0] != 0);
+		// flip the augmenting path
+		do
+		{
+			int j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+	for (int j = 1; j <= d; j++)
+	{
+		int i = p[j];
+		if (i != 0 && cost[size_t(i) * (m + 1) + j] < FORBIDDEN_COST)
+		{
+			match[markers[i - 1]] = detections[j - 1];
+		}
+	}
+}
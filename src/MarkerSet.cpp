@@ -0,0 +1,67 @@
+// marker的数量和名称在运行时从配置文件读取
+#include "MarkerSet.hpp"
+#include "Tracker.hpp"
+#include <iostream>
+
+
+MarkerSet::MarkerSet()
+{
+	UseDefault();
+}
+
+// the six markers of the two leg segments and the foot, as placed for gait recording
+void MarkerSet::UseDefault()
+{
+	const char* leg[] = { "thigh_upper", "thigh_lower", "shank_upper", "shank_lower", "foot_heel", "foot_toe" };
+	names.assign(leg, leg + 6);
+}
+
+// This function reads the marker names from a YAML or XML file, the set is left unchanged on failure
+bool MarkerSet::Load(const std::string& path)
+{
+	cv::FileStorage fs;
+	try
+	{
+		if (!fs.open(path, cv::FileStorage::READ))
+		{
+			std::cout << "Marker set " << path << " can not be opened" << std::endl;
+			return false;
+		}
+	}
+	catch (cv::Exception& e)
+	{
+		std::cout << "OpenCV Error: while reading marker set " << path << ": \n" << e.what() << std::endl;
+		return false;
+	}
+	cv::FileNode node = fs["markers"];
+	if (!node.isSeq() || node.size() == 0)
+	{
+		std::cout << "Marker set " << path << " has no marker list" << std::endl;
+		return false;
+	}
+	if (int(node.size()) > MAX_MARKERS)
+	{
+		std::cout << "Marker set " << path << " has " << node.size() << " markers, at most " << MAX_MARKERS << " are supported" << std::endl;
+		return false;
+	}
+	std::vector<std::string> loaded;
+	for (int k = 0; k < int(node.size()); k++)
+	{
+		loaded.push_back(std::string(node[k]));
+	}
+	names.swap(loaded);
+	return true;
+}
+
+// index of the marker with the given name, -1 if the set has no such marker
+int MarkerSet::Find(const std::string& name) const
+{
+	for (size_t k = 0; k < names.size(); k++)
+	{
+		if (names[k] == name)
+		{
+			return int(k);
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,188 @@
+// 把MATLAB的MAT文件（v6，不压缩）映射到内存，数组直接指向映射的数据，不做拷贝
+#include "MatFile.h"
+#include <iostream>
+#include <cstring>
+
+// data types and array classes of the level 5 MAT format
+enum { miINT8 = 1, miUINT8, miINT16, miUINT16, miINT32, miUINT32, miSINGLE, miDOUBLE = 9, miINT64 = 12, miUINT64, miMATRIX = 14, miCOMPRESSED = 15 };
+const int mxDOUBLE_CLASS = 6, mxUINT64_CLASS = 15; // the numeric classes
+const uint32_t MX_COMPLEX_FLAG = 0x800;
+const size_t MAT_HEADER_SIZE = 128;
+
+// A data element: its type, size and first data byte. Small elements keep up to 4 data bytes in the tag.
+struct MatElement
+{
+	uint32_t type;
+	uint32_t size;
+	const uint8_t* data;
+	size_t total; // bytes of tag, data and padding
+};
+
+static bool ReadElement(const uint8_t* p, size_t available, MatElement& element)
+{
+	if (available < 8)
+	{
+		return false;
+	}
+	uint32_t word0, word1;
+	std::memcpy(&word0, p, 4);
+	std::memcpy(&word1, p + 4, 4);
+	if (word0 >> 16)
+	{
+		element.type = word0 & 0xffff;
+		element.size = word0 >> 16;
+		element.data = p + 4;
+		element.total = 8;
+		return element.size <= 4;
+	}
+	element.type = word0;
+	element.size = word1;
+	element.data = p + 8;
+	// compressed elements are not padded
+	element.total = 8 + (word0 == miCOMPRESSED ? size_t(word1) : (size_t(word1) + 7) / 8 * 8);
+	return element.total <= available;
+}
+
+template<class T>
+static void Widen(const uint8_t* data, size_t count, std::vector<double>& out)
+{
+	out.resize(count);
+	for (size_t k = 0; k < count; k++)
+	{
+		T value;
+		std::memcpy(&value, data + k * sizeof(T), sizeof(T));
+		out[k] = double(value);
+	}
+}
+
+
+MatFile::MatFile()
+{
+}
+
+MatFile::~MatFile()
+{
+	Close();
+}
+
+void MatFile::Close()
+{
+	arrays.clear();
+	widened.clear();
+	file.Close();
+}
+
+// This function maps the file and collects its arrays, it returns false when the file is no little-endian level 5 MAT file
+bool MatFile::Open(const std::string& path)
+{
+	Close();
+	if (!file.Open(path))
+	{
+		std::cout << "MAT file " << path << " can not be opened" << std::endl;
+		return false;
+	}
+	const uint8_t* mapped = file.data;
+	const size_t mappedSize = file.size;
+	if (mappedSize < MAT_HEADER_SIZE || std::memcmp(mapped + 126, "IM", 2) != 0)
+	{
+		std::cout << "MAT file " << path << " is no little-endian level 5 MAT file" << std::endl;
+		Close();
+		return false;
+	}
+	size_t position = MAT_HEADER_SIZE;
+	MatElement element;
+	while (ReadElement(mapped + position, mappedSize - position, element))
+	{
+		if (element.type == miCOMPRESSED)
+		{
+			std::cout << "MAT file " << path << " has a compressed variable, save it with '-v6' to read it" << std::endl;
+		}
+		else if (element.type == miMATRIX)
+		{
+			ReadMatrix(element.data, element.size);
+		}
+		position += element.total;
+	}
+	return true;
+}
+
+// This function adds a real two-dimensional numeric array, other arrays (objects, structs, cells, sparse, complex) are skipped
+bool MatFile::ReadMatrix(const uint8_t* p, size_t size)
+{
+	MatElement flags, dims, name, real;
+	if (!ReadElement(p, size, flags) || flags.type != miUINT32 || flags.size < 8)
+	{
+		return false;
+	}
+	p += flags.total;
+	size -= flags.total;
+	if (!ReadElement(p, size, dims) || dims.type != miINT32 || dims.size != 8)
+	{
+		return false;
+	}
+	p += dims.total;
+	size -= dims.total;
+	if (!ReadElement(p, size, name) || name.type != miINT8)
+	{
+		return false;
+	}
+	p += name.total;
+	size -= name.total;
+	uint32_t flagWord;
+	std::memcpy(&flagWord, flags.data, 4);
+	const int arrayClass = flagWord & 0xff;
+	if (arrayClass < mxDOUBLE_CLASS || arrayClass > mxUINT64_CLASS || (flagWord & MX_COMPLEX_FLAG) || !ReadElement(p, size, real))
+	{
+		return false;
+	}
+	MatArray array;
+	int32_t extent[2];
+	std::memcpy(extent, dims.data, 8);
+	array.name.assign((const char*)name.data, name.size);
+	array.rows = extent[0];
+	array.cols = extent[1];
+	const size_t count = array.size();
+	static const size_t typeSize[] = { 0, 1, 1, 2, 2, 4, 4, 4, 0, 8, 0, 0, 8, 8 };
+	if (real.type >= sizeof(typeSize) / sizeof(typeSize[0]) || typeSize[real.type] == 0 || real.size < count * typeSize[real.type])
+	{
+		return false;
+	}
+	// elements start on 8 byte boundaries of the mapping, unless a compressed element before them was not padded
+	if (real.type == miDOUBLE && uintptr_t(real.data) % sizeof(double) == 0)
+	{
+		array.data = (const double*)real.data;
+	}
+	else
+	{
+		widened.push_back(std::vector<double>());
+		std::vector<double>& copy = widened.back();
+		switch (real.type)
+		{
+		case miDOUBLE: Widen<double>(real.data, count, copy); break;
+		case miINT8: Widen<int8_t>(real.data, count, copy); break;
+		case miUINT8: Widen<uint8_t>(real.data, count, copy); break;
+		case miINT16: Widen<int16_t>(real.data, count, copy); break;
+		case miUINT16: Widen<uint16_t>(real.data, count, copy); break;
+		case miINT32: Widen<int32_t>(real.data, count, copy); break;
+		case miUINT32: Widen<uint32_t>(real.data, count, copy); break;
+		case miSINGLE: Widen<float>(real.data, count, copy); break;
+		case miINT64: Widen<int64_t>(real.data, count, copy); break;
+		default: Widen<uint64_t>(real.data, count, copy); break;
+		}
+		array.data = copy.empty() ? NULL : &copy[0];
+	}
+	arrays.push_back(array);
+	return true;
+}
+
+const MatArray* MatFile::Find(const std::string& name) const
+{
+	for (size_t k = 0; k < arrays.size(); k++)
+	{
+		if (arrays[k].name == name)
+		{
+			return &arrays[k];
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,106 @@
+// 每个相机中每个marker的卡尔曼滤波运动模型
+#include "MotionModel.hpp"
+#include <algorithm>
+
+
+MarkerKalman::MarkerKalman():initialized(false),jerkNoise(0.5),measurementNoise(1.5)
+{
+	filter.init(6, 2, 0, CV_32F);
+}
+
+
+MarkerKalman::~MarkerKalman()
+{
+}
+
+// This function resets the filter to a marker at rest at the given position
+void MarkerKalman::Init(cv::Point2f position)
+{
+	// x' = x + v + a/2, v' = v + a, a' = a (dt is one frame)
+	filter.transitionMatrix = (cv::Mat_<float>(6, 6) <<
+		1, 0, 1, 0, 0.5f, 0,
+		0, 1, 0, 1, 0, 0.5f,
+		0, 0, 1, 0, 1, 0,
+		0, 0, 0, 1, 0, 1,
+		0, 0, 0, 0, 1, 0,
+		0, 0, 0, 0, 0, 1);
+	filter.measurementMatrix = cv::Mat::zeros(2, 6, CV_32F);
+	filter.measurementMatrix.at<float>(0, 0) = 1.0f;
+	filter.measurementMatrix.at<float>(1, 1) = 1.0f;
+
+	// white jerk noise: Q = G * G^T * sigma^2 with G = (1/6, 1/2, 1) on each axis
+	const float g[3] = { 1.0f / 6.0f, 0.5f, 1.0f };
+	const float q = static_cast<float>(jerkNoise * jerkNoise);
+	filter.processNoiseCov = cv::Mat::zeros(6, 6, CV_32F);
+	for (int axis = 0; axis < 2; axis++)
+	{
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				filter.processNoiseCov.at<float>(2 * r + axis, 2 * c + axis) = g[r] * g[c] * q;
+			}
+		}
+	}
+	cv::setIdentity(filter.measurementNoiseCov, cv::Scalar(measurementNoise * measurementNoise));
+
+	// position is known from detection, velocity and acceleration are not
+	filter.errorCovPost = cv::Mat::zeros(6, 6, CV_32F);
+	filter.errorCovPost.at<float>(0, 0) = filter.errorCovPost.at<float>(1, 1) = 4.0f;
+	filter.errorCovPost.at<float>(2, 2) = filter.errorCovPost.at<float>(3, 3) = 100.0f;
+	filter.errorCovPost.at<float>(4, 4) = filter.errorCovPost.at<float>(5, 5) = 25.0f;
+	filter.statePost = cv::Mat::zeros(6, 1, CV_32F);
+	filter.statePost.at<float>(0) = position.x;
+	filter.statePost.at<float>(1) = position.y;
+	prediction = position;
+	initialized = true;
+}
+
+// This function moves the filter one frame ahead and returns the predicted position.
+// If no measurement follows, the prediction becomes the new state and its covariance keeps growing.
+cv::Point2f MarkerKalman::Predict()
+{
+	const cv::Mat& state = filter.predict();
+	prediction = cv::Point2f(state.at<float>(0), state.at<float>(1));
+	return prediction;
+}
+
+void MarkerKalman::Correct(cv::Point2f measurement)
+{
+	cv::Mat z = (cv::Mat_<float>(2, 1) << measurement.x, measurement.y);
+	filter.correct(z);
+}
+
+// The window is the 3-sigma gate of the innovation covariance S = H * P * H^T + R,
+// so it shrinks while the marker moves smoothly and grows when it accelerates or is missed
+cv::Size MarkerKalman::WindowSize() const
+{
+	double sxx = filter.errorCovPre.at<float>(0, 0) + filter.measurementNoiseCov.at<float>(0, 0);
+	double syy = filter.errorCovPre.at<float>(1, 1) + filter.measurementNoiseCov.at<float>(1, 1);
+	return GateWindow(sxx, syy);
+}
+
+// size of the window holding the 3-sigma gate of an innovation with these variances, within the window limits
+cv::Size MarkerKalman::GateWindow(double sxx, double syy)
+{
+	int dimX = 2 * (int(GATE_SIGMA * std::sqrt(sxx)) + MARKER_RADIUS);
+	int dimY = 2 * (int(GATE_SIGMA * std::sqrt(syy)) + MARKER_RADIUS);
+	dimX = std::min(std::max(dimX, MIN_WINDOW_DIM), MAX_WINDOW_DIM);
+	dimY = std::min(std::max(dimY, MIN_WINDOW_DIM), MAX_WINDOW_DIM);
+	return cv::Size(dimX, dimY);
+}
+
+// radius of the 3-sigma gate around the prediction along its more uncertain axis, without the window limits
+double MarkerKalman::GateRadius() const
+{
+	double sxx = filter.errorCovPre.at<float>(0, 0) + filter.measurementNoiseCov.at<float>(0, 0);
+	double syy = filter.errorCovPre.at<float>(1, 1) + filter.measurementNoiseCov.at<float>(1, 1);
+	return GATE_SIGMA * std::sqrt(std::max(sxx, syy)) + MARKER_RADIUS;
+}
+
+// search window centered on the last prediction
+cv::Rect MarkerKalman::SearchWindow() const
+{
+	cv::Size size = WindowSize();
+	return cv::Rect(cvRound(prediction.x) - size.width / 2, cvRound(prediction.y) - size.height / 2, size.width, size.height);
+}
@@ -0,0 +1,216 @@
+// 在后台线程中全画面重新寻找丢失的marker
+#include "Reacquisition.hpp"
+#include <algorithm>
+
+
+ReacquisitionWorker::ReacquisitionWorker() :running(true)
+{
+	for (int i = 0; i < NUM_CAMERAS; i++)
+	{
+		requested[i] = false;
+		ready[i] = false;
+		for (int j = 0; j < MAX_MARKERS; j++)
+		{
+			lost[i][j] = false;
+		}
+	}
+	worker = std::thread(&ReacquisitionWorker::Run, this);
+}
+
+
+ReacquisitionWorker::~ReacquisitionWorker()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		running = false;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+// This function is called once per frame after tracking. It merges what the worker found since the
+// last frame, starts the lost-marker timers and hands the frames of cameras with lost markers to the worker.
+// If the worker holds the lock the frame loop skips this frame instead of waiting.
+void ReacquisitionWorker::Update(Tracker& tracker)
+{
+	std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+	if (!guard.owns_lock())
+	{
+		return;
+	}
+	auto now = std::chrono::high_resolution_clock::now();
+	bool requestedAny = false;
+	for (int i = 0; i < NUM_CAMERAS; i++)
+	{
+		if (ready[i])
+		{
+			Merge(tracker, i, found[i]);
+			ready[i] = false;
+		}
+		bool needSearch = false;
+		for (int j = 0; j < Tracker::numMarkers; j++)
+		{
+			int lostFrames = tracker.lostFrames[i][j];
+			if (lostFrames > 0 && !lost[i][j])
+			{
+				lost[i][j] = true;
+				lostSince[i][j] = now;
+			}
+			else if (lostFrames == 0 && lost[i][j])
+			{
+				lost[i][j] = false;
+				std::chrono::duration<double> elapsed = now - lostSince[i][j];
+				std::cout << "Camera " << i << " marker " << j << " recovered by tracking after " << elapsed.count() << " s" << std::endl;
+			}
+			needSearch = needSearch || lostFrames >= REACQUIRE_AFTER_FRAMES;
+		}
+		if (needSearch && !requested[i])
+		{
+			// copyTo reuses the buffer, the camera image is overwritten by the next acquisition
+			tracker.ReceivedImages[i].copyTo(pending[i]);
+			requested[i] = true;
+			requestedAny = true;
+		}
+	}
+	guard.unlock();
+	if (requestedAny)
+	{
+		wake.notify_one();
+	}
+}
+
+void ReacquisitionWorker::Run()
+{
+	cv::Mat frame;
+	std::vector<cv::Point2f> candidates;
+	std::unique_lock<std::mutex> guard(lock);
+	while (running)
+	{
+		int camera_index = -1;
+		for (int i = 0; i < NUM_CAMERAS; i++)
+		{
+			if (requested[i] && !ready[i])
+			{
+				camera_index = i;
+				break;
+			}
+		}
+		if (camera_index < 0)
+		{
+			wake.wait(guard);
+			continue;
+		}
+		// search without the lock so the frame loop can keep going
+		cv::swap(frame, pending[camera_index]);
+		guard.unlock();
+		// the range is double buffered, reading it while the frame loop derives a new one is safe
+		Search(frame, Tracker::thresholds[camera_index].Range(), candidates);
+		guard.lock();
+		cv::swap(frame, pending[camera_index]);
+		found[camera_index] = candidates;
+		ready[camera_index] = true;
+		requested[camera_index] = false;
+	}
+}
+
+// This function detects every marker-coloured blob of a downsampled frame,
+// the candidates are returned in full image coordinates
+void ReacquisitionWorker::Search(const cv::Mat& frame, const HsvRange& range, std::vector<cv::Point2f>& candidates)
+{
+	candidates.clear();
+	if (frame.empty())
+	{
+		return;
+	}
+	cv::Mat small, hsv, rangeRes;
+	cv::resize(frame, small, cv::Size(frame.cols / REACQUIRE_DOWNSAMPLE, frame.rows / REACQUIRE_DOWNSAMPLE), 0, 0, cv::INTER_AREA);
+	cv::cvtColor(small, hsv, CV_RGB2HSV);
+	cv::inRange(hsv, cv::Scalar(range.hMin, range.sMin, range.vMin), cv::Scalar(range.hMax, range.sMax, range.vMax), rangeRes);
+	cv::Mat mask(3, 3, CV_8U, cv::Scalar(1));
+	cv::morphologyEx(rangeRes, rangeRes, cv::MORPH_CLOSE, mask);
+	std::vector<std::vector<cv::Point>>contours;
+	cv::findContours(rangeRes, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE);
+	for (size_t k = 0; k < contours.size(); k++)
+	{
+		cv::Rect br = cv::boundingRect(contours[k]);
+		float cx = (br.x + br.width * 0.5f) * REACQUIRE_DOWNSAMPLE;
+		float cy = (br.y + br.height * 0.5f) * REACQUIRE_DOWNSAMPLE;
+		candidates.push_back(cv::Point2f(cx, cy));
+	}
+}
+
+// This function gives the candidates to the markers that are still lost, nearest to their prediction first.
+// A candidate outside the gate of every lost marker is not taken.
+// Candidates next to markers that are tracked fine are left alone.
+void ReacquisitionWorker::Merge(Tracker& tracker, int camera_index, const std::vector<cv::Point2f>& candidates)
+{
+	std::vector<cv::Point2f> unclaimed;
+	const BitMask* allowed = Tracker::AllowedMask(camera_index);
+	for (size_t k = 0; k < candidates.size(); k++)
+	{
+		cv::Point at(candidates[k]);
+		bool taken = allowed && cv::Rect(0, 0, allowed->width, allowed->height).contains(at) && !allowed->Get(at.x, at.y);
+		for (int j = 0; j < Tracker::numMarkers && !taken; j++)
+		{
+			if (tracker.lostFrames[camera_index][j] == 0)
+			{
+				taken = cv::norm(candidates[k] - cv::Point2f(tracker.currentPos[camera_index][j])) < REACQUIRE_MIN_SEPARATION;
+			}
+		}
+		if (!taken)
+		{
+			unclaimed.push_back(candidates[k]);
+		}
+	}
+	// (distance, marker, candidate), matched greedily from the closest pair. A candidate is only paired with a marker
+	// it could be: inside the Kalman gate of the marker, which grows with every frame the marker stays lost,
+	// and no farther than the marker can have moved since it was lost, so a reflection elsewhere in the image is left alone.
+	std::vector<std::pair<double, std::pair<int, int>>> pairs;
+	for (int j = 0; j < Tracker::numMarkers; j++)
+	{
+		const int lostFrames = tracker.lostFrames[camera_index][j];
+		if (lostFrames < REACQUIRE_AFTER_FRAMES)
+		{
+			continue;
+		}
+		const MarkerKalman& model = tracker.motionModel[camera_index][j];
+		// while lost the position follows the prediction of the motion model or of the stereo pair
+		cv::Point2f predicted = tracker.currentPos[camera_index][j];
+		double gate = MARKER_RADIUS + REACQUIRE_MAX_STEP * lostFrames;
+		if (model.initialized)
+		{
+			gate = std::min(gate, model.GateRadius());
+		}
+		// the candidates come from a 1/REACQUIRE_DOWNSAMPLE image
+		gate += REACQUIRE_DOWNSAMPLE;
+		for (size_t k = 0; k < unclaimed.size(); k++)
+		{
+			const double distance = cv::norm(unclaimed[k] - predicted);
+			if (distance <= gate)
+			{
+				pairs.push_back(std::make_pair(distance, std::make_pair(j, int(k))));
+			}
+		}
+	}
+	std::sort(pairs.begin(), pairs.end());
+	std::vector<bool> markerDone(Tracker::numMarkers, false), candidateDone(unclaimed.size(), false);
+	auto now = std::chrono::high_resolution_clock::now();
+	for (size_t p = 0; p < pairs.size(); p++)
+	{
+		int j = pairs[p].second.first;
+		int k = pairs[p].second.second;
+		if (markerDone[j] || candidateDone[k])
+		{
+			continue;
+		}
+		markerDone[j] = candidateDone[k] = true;
+		cv::Point position(cvRound(unclaimed[k].x), cvRound(unclaimed[k].y));
+		tracker.currentPos[camera_index][j] = position;
+		tracker.motionModel[camera_index][j].Init(position);
+		tracker.lostFrames[camera_index][j] = 0;
+		tracker.lastSeenWindow[camera_index][j] = cv::Rect(position.x - MARKER_RADIUS, position.y - MARKER_RADIUS, 2 * MARKER_RADIUS + 1, 2 * MARKER_RADIUS + 1);
+		lost[camera_index][j] = false;
+		std::chrono::duration<double> elapsed = now - lostSince[camera_index][j];
+		std::cout << "Camera " << camera_index << " marker " << j << " reacquired after " << elapsed.count() << " s" << std::endl;
+	}
+}
@@ -0,0 +1,221 @@
+// 读取和保存每个相机的标定结果（内参、畸变、相对于相机对第一个相机的外参）
+#include "RigCalibration.h"
+#include "MatFile.h"
+#include <sstream>
+#include <iostream>
+
+
+RigCalibration::RigCalibration() :numCameras(NUM_CAMERAS)
+{
+	UseDefault();
+}
+
+// the rig before it was calibrated per camera: one set of intrinsics for every camera, no distortion,
+// the second camera of a pair sits 200 mm below the first one
+void RigCalibration::UseDefault()
+{
+	const double cx = 1124.8, cy = 1126.0, fx = 1018.7, fy = 1002.1;
+	const double baseline = 200;
+	const cv::Point2i cameraOffset[4] = { cv::Point(500, 500), cv::Point(500,300), cv::Point(750,500), cv::Point(800,300) };
+	numCameras = NUM_CAMERAS;
+	for (int i = 0; i < NUM_CAMERAS; i++)
+	{
+		cameras[i] = CameraModel();
+		cameras[i].K = cv::Matx33d(fx, 0, cx, 0, fy, cy, 0, 0, 1);
+		cameras[i].offset = cv::Point2d(cameraOffset[i % 4]);
+		cameras[i].pair = i / 2;
+		cameras[i].t = (i % 2 == 0) ? cv::Vec3d(0, 0, 0) : cv::Vec3d(0, -baseline, 0);
+	}
+}
+
+// This function reads a matrix of the given size, out is left unchanged when the node does not hold one
+template<int rows, int cols>
+static bool ReadMatx(const cv::FileNode& node, cv::Matx<double, rows, cols>& out)
+{
+	cv::Mat m;
+	node >> m;
+	if (m.empty() || int(m.total()) != rows * cols)
+	{
+		return false;
+	}
+	m.convertTo(m, CV_64F);
+	m = m.reshape(1, rows);
+	for (int r = 0; r < rows; r++)
+	{
+		for (int c = 0; c < cols; c++)
+		{
+			out(r, c) = m.at<double>(r, c);
+		}
+	}
+	return true;
+}
+
+template<int rows, int cols>
+static cv::Mat ToMat(const cv::Matx<double, rows, cols>& m)
+{
+	return cv::Mat(rows, cols, CV_64F, (void*)m.val).clone();
+}
+
+// This function reads the calibration, cameras missing from the file or incomplete keep their previous model
+bool RigCalibration::Load(const std::string& path)
+{
+	cv::FileStorage fs;
+	try
+	{
+		if (!fs.open(path, cv::FileStorage::READ))
+		{
+			std::cout << "Rig calibration " << path << " can not be opened" << std::endl;
+			return false;
+		}
+		int loaded = 0;
+		for (int i = 0; i < NUM_CAMERAS; i++)
+		{
+			std::ostringstream name;
+			name << "camera" << i;
+			cv::FileNode node = fs[name.str()];
+			if (node.empty())
+			{
+				continue;
+			}
+			CameraModel camera = cameras[i];
+			cv::Matx31d t;
+			if (!ReadMatx(node["K"], camera.K) || !ReadMatx(node["R"], camera.R) || !ReadMatx(node["t"], t))
+			{
+				std::cout << "Camera " << i << " of rig calibration " << path << " is incomplete" << std::endl;
+				continue;
+			}
+			camera.t = cv::Vec3d(t(0), t(1), t(2));
+			cv::Matx<double, 5, 1> distortion;
+			if (ReadMatx(node["distortion"], distortion))
+			{
+				camera.distortion = cv::Vec<double, 5>(distortion.val);
+			}
+			if (!node["offset"].empty())
+			{
+				camera.offset = cv::Point2d(double(node["offset"][0]), double(node["offset"][1]));
+			}
+			if (!node["binning"].empty())
+			{
+				camera.binning = double(node["binning"]);
+			}
+			if (!node["pair"].empty())
+			{
+				camera.pair = int(node["pair"]);
+			}
+			cameras[i] = camera;
+			loaded++;
+		}
+		std::cout << "Rig calibration " << path << " has " << loaded << " cameras" << std::endl;
+		return loaded > 0;
+	}
+	catch (cv::Exception& e)
+	{
+		std::cout << "OpenCV Error: while reading rig calibration " << path << ": \n" << e.what() << std::endl;
+		return false;
+	}
+}
+
+// This function reads an array of rows x cols values, a row vector is accepted for a column vector
+template<int rows, int cols>
+static bool ReadMatx(const MatFile& mat, const std::string& name, cv::Matx<double, rows, cols>& out)
+{
+	const MatArray* array = mat.Find(name);
+	if (!array || int(array->size()) != rows * cols)
+	{
+		return false;
+	}
+	for (int r = 0; r < rows; r++)
+	{
+		for (int c = 0; c < cols; c++)
+		{
+			out(r, c) = array->rows == rows ? array->at(r, c) : array->data[r * cols + c];
+		}
+	}
+	return true;
+}
+
+// This function reads the calibration from a MAT file exported from MATLAB, the file is mapped and not parsed into copies.
+// Cameras missing from the file or incomplete keep their previous model.
+bool RigCalibration::LoadMat(const std::string& path)
+{
+	MatFile mat;
+	if (!mat.Open(path))
+	{
+		return false;
+	}
+	int loaded = 0;
+	for (int i = 0; i < NUM_CAMERAS; i++)
+	{
+		std::ostringstream name;
+		name << "camera" << i << "_";
+		const std::string prefix = name.str();
+		CameraModel camera = cameras[i];
+		cv::Matx31d t;
+		if (!ReadMatx(mat, prefix + "K", camera.K) || !ReadMatx(mat, prefix + "R", camera.R) || !ReadMatx(mat, prefix + "t", t))
+		{
+			continue;
+		}
+		// MATLAB counts pixels from 1, the principal point moves to OpenCV's 0-based pixel centres
+		camera.K(0, 2) -= 1;
+		camera.K(1, 2) -= 1;
+		camera.t = cv::Vec3d(t(0), t(1), t(2));
+		cv::Matx<double, 5, 1> distortion;
+		if (ReadMatx(mat, prefix + "distortion", distortion))
+		{
+			camera.distortion = cv::Vec<double, 5>(distortion.val);
+		}
+		cv::Matx21d offset;
+		if (ReadMatx(mat, prefix + "offset", offset))
+		{
+			camera.offset = cv::Point2d(offset(0), offset(1));
+		}
+		const MatArray* binning = mat.Find(prefix + "binning");
+		if (binning && binning->size() == 1)
+		{
+			camera.binning = binning->data[0];
+		}
+		const MatArray* pair = mat.Find(prefix + "pair");
+		if (pair && pair->size() == 1)
+		{
+			camera.pair = int(pair->data[0]);
+		}
+		cameras[i] = camera;
+		loaded++;
+	}
+	std::cout << "Rig calibration " << path << " has " << loaded << " cameras" << std::endl;
+	return loaded > 0;
+}
+
+bool RigCalibration::Save(const std::string& path) const
+{
+	try
+	{
+		cv::FileStorage fs(path, cv::FileStorage::WRITE);
+		if (!fs.isOpened())
+		{
+			std::cout << "Rig calibration " << path << " can not be written" << std::endl;
+			return false;
+		}
+		for (int i = 0; i < numCameras; i++)
+		{
+			const CameraModel& camera = cameras[i];
+			std::ostringstream name;
+			name << "camera" << i;
+			fs << name.str() << "{";
+			fs << "K" << ToMat(camera.K);
+			fs << "distortion" << ToMat(cv::Matx<double, 5, 1>(camera.distortion.val));
+			fs << "R" << ToMat(camera.R);
+			fs << "t" << ToMat(cv::Matx31d(camera.t.val));
+			fs << "offset" << "[" << camera.offset.x << camera.offset.y << "]";
+			fs << "binning" << camera.binning;
+			fs << "pair" << camera.pair;
+			fs << "}";
+		}
+	}
+	catch (cv::Exception& e)
+	{
+		std::cout << "OpenCV Error: while writing rig calibration " << path << ": \n" << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
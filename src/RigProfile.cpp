@@ -0,0 +1,144 @@
+// 保存实验室中每个相机需要忽略的静态红色干扰区域
+#include "RigProfile.hpp"
+#include <sstream>
+
+
+RigProfile::RigProfile()
+{
+}
+
+bool RigProfile::Load(const std::string& path)
+{
+	cv::FileStorage fs;
+	try
+	{
+		if (!fs.open(path, cv::FileStorage::READ))
+		{
+			std::cout << "Rig profile " << path << " can not be opened" << std::endl;
+			return false;
+		}
+		for (int i = 0; i < NUM_CAMERAS; i++)
+		{
+			std::ostringstream name;
+			name << "camera" << i;
+			cv::FileNode camera = fs[name.str()];
+			exclusions[i].clear();
+			imageSize[i] = cv::Size();
+			if (camera.empty())
+			{
+				continue;
+			}
+			imageSize[i] = cv::Size(int(camera["width"]), int(camera["height"]));
+			cv::FileNode rects = camera["exclusions"];
+			for (int k = 0; k + 3 < int(rects.size()); k += 4)
+			{
+				exclusions[i].push_back(cv::Rect(int(rects[k]), int(rects[k + 1]), int(rects[k + 2]), int(rects[k + 3])));
+			}
+			std::cout << "Camera " << i << " ignores " << exclusions[i].size() << " regions of " << path << std::endl;
+		}
+	}
+	catch (cv::Exception& e)
+	{
+		std::cout << "OpenCV Error: while reading rig profile " << path << ": \n" << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool RigProfile::Save(const std::string& path) const
+{
+	try
+	{
+		cv::FileStorage fs(path, cv::FileStorage::WRITE);
+		if (!fs.isOpened())
+		{
+			std::cout << "Rig profile " << path << " can not be written" << std::endl;
+			return false;
+		}
+		for (int i = 0; i < NUM_CAMERAS; i++)
+		{
+			if (imageSize[i].area() == 0)
+			{
+				continue;
+			}
+			std::ostringstream name;
+			name << "camera" << i;
+			std::vector<int> rects;
+			for (size_t k = 0; k < exclusions[i].size(); k++)
+			{
+				const cv::Rect& r = exclusions[i][k];
+				rects.push_back(r.x);
+				rects.push_back(r.y);
+				rects.push_back(r.width);
+				rects.push_back(r.height);
+			}
+			fs << name.str() << "{" << "width" << imageSize[i].width << "height" << imageSize[i].height << "exclusions" << rects << "}";
+		}
+	}
+	catch (cv::Exception& e)
+	{
+		std::cout << "OpenCV Error: while writing rig profile " << path << ": \n" << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// This function lets the user draw the exclusion rectangles of every camera with the mouse.
+// Drag a rectangle and press a to add it, press any other key to go on to the next camera.
+void RigProfile::AuthorExclusions(const cv::Mat images[], int numCameras)
+{
+	cv::namedWindow("exclusions", 0);
+	cv::setMouseCallback("exclusions", Tracker::Mouse_getRegion, 0);
+	for (int i = 0; i < numCameras && i < NUM_CAMERAS; i++)
+	{
+		imageSize[i] = images[i].size();
+		exclusions[i].clear();
+		Tracker::calibration_region = cv::Rect();
+		while (true)
+		{
+			cv::Mat shown = images[i].clone();
+			for (size_t k = 0; k < exclusions[i].size(); k++)
+			{
+				cv::rectangle(shown, exclusions[i][k], cv::Scalar(0, 0, 255), -1);
+			}
+			cv::rectangle(shown, Tracker::calibration_region, cv::Scalar(255, 255, 0), 2);
+			cv::imshow("exclusions", shown);
+			int key = cv::waitKey(30);
+			if (key == 'a')
+			{
+				cv::Rect r = Tracker::calibration_region & cv::Rect(0, 0, images[i].cols, images[i].rows);
+				if (r.area() > 0)
+				{
+					exclusions[i].push_back(r);
+				}
+				Tracker::calibration_region = cv::Rect();
+			}
+			else if (key >= 0)
+			{
+				break;
+			}
+		}
+		std::cout << "Camera " << i << " ignores " << exclusions[i].size() << " regions" << std::endl;
+	}
+	cv::destroyWindow("exclusions");
+}
+
+// This function packs the usable pixels of every camera, 1 outside all exclusions.
+// Cameras without exclusions get an empty mask, which the segmentation skips.
+void RigProfile::BuildMasks(BitMask masks[]) const
+{
+	for (int i = 0; i < NUM_CAMERAS; i++)
+	{
+		masks[i] = BitMask();
+		if (exclusions[i].empty() || imageSize[i].area() == 0)
+		{
+			continue;
+		}
+		masks[i].Create(imageSize[i].width, imageSize[i].height);
+		std::fill(masks[i].words.begin(), masks[i].words.end(), ~MaskWord(0));
+		for (size_t k = 0; k < exclusions[i].size(); k++)
+		{
+			masks[i].Clear(exclusions[i][k]);
+		}
+	}
+}
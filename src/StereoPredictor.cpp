@@ -0,0 +1,199 @@
+// 利用三维轨迹预测每个相机中marker的位置
+#include "StereoPredictor.h"
+#include <algorithm>
+#include <limits>
+
+const int MAX_LOST_FRAMES_3D = 10; // restart the 3D filter after this many frames without any view
+
+
+MarkerKalman3D::MarkerKalman3D() :initialized(false), accelerationNoise(30.0), pointNoise(10.0), pixelNoise(1.5)
+{
+}
+
+void MarkerKalman3D::Init(const cv::Point3d& position)
+{
+	x = cv::Vec6d(position.x, position.y, position.z, 0, 0, 0);
+	P = cv::Matx66d::zeros();
+	for (int i = 0; i < 3; i++)
+	{
+		P(i, i) = pointNoise * pointNoise;
+		P(i + 3, i + 3) = 100.0 * 100.0; // velocity is unknown, up to 3 m/s at 30 fps
+	}
+	initialized = true;
+}
+
+// x' = x + v, v' = v, white acceleration noise
+void MarkerKalman3D::Predict()
+{
+	cv::Matx66d F = cv::Matx66d::eye();
+	for (int i = 0; i < 3; i++)
+	{
+		F(i, i + 3) = 1.0;
+	}
+	const double q = accelerationNoise * accelerationNoise;
+	cv::Matx66d Q = cv::Matx66d::zeros();
+	for (int i = 0; i < 3; i++)
+	{
+		Q(i, i) = 0.25 * q;
+		Q(i, i + 3) = Q(i + 3, i) = 0.5 * q;
+		Q(i + 3, i + 3) = q;
+	}
+	x = F * x;
+	P = F * P * F.t() + Q;
+}
+
+void MarkerKalman3D::Correct(const cv::Point3d& position)
+{
+	cv::Matx<double, 3, 6> H = cv::Matx<double, 3, 6>::zeros();
+	H(0, 0) = H(1, 1) = H(2, 2) = 1.0;
+	cv::Matx33d S = H * P * H.t() + cv::Matx33d::eye() * (pointNoise * pointNoise);
+	cv::Matx<double, 6, 3> gain = P * H.t() * S.inv();
+	cv::Vec3d residual(position.x - x[0], position.y - x[1], position.z - x[2]);
+	x += gain * residual;
+	P = (cv::Matx66d::eye() - gain * H) * P;
+}
+
+// extended Kalman update with the image position seen by one camera
+void MarkerKalman3D::CorrectView(const CameraModel& camera, const cv::Point2d& observation)
+{
+	cv::Point3d p = Position();
+	if (!camera.InFront(p))
+	{
+		return;
+	}
+	cv::Matx23d J = camera.ProjectJacobian(p);
+	cv::Matx<double, 2, 6> H = cv::Matx<double, 2, 6>::zeros();
+	for (int r = 0; r < 2; r++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			H(r, c) = J(r, c);
+		}
+	}
+	cv::Matx22d S = H * P * H.t() + cv::Matx22d::eye() * (pixelNoise * pixelNoise);
+	cv::Matx<double, 6, 2> gain = P * H.t() * S.inv();
+	cv::Point2d predicted = camera.Project(p);
+	cv::Vec2d residual(observation.x - predicted.x, observation.y - predicted.y);
+	x += gain * residual;
+	P = (cv::Matx66d::eye() - gain * H) * P;
+}
+
+cv::Point3d MarkerKalman3D::Position() const
+{
+	return cv::Point3d(x[0], x[1], x[2]);
+}
+
+cv::Matx33d MarkerKalman3D::PositionCov() const
+{
+	return P.get_minor<3, 3>(0, 0);
+}
+
+
+StereoPredictor::StereoPredictor()
+{
+}
+
+
+StereoPredictor::~StereoPredictor()
+{
+}
+
+void StereoPredictor::Reset()
+{
+	for (int i = 0; i < NUM_CAMERAS / 2; i++)
+	{
+		for (int j = 0; j < MAX_MARKERS; j++)
+		{
+			filter[i][j].initialized = false;
+		}
+	}
+}
+
+// This function corrects the 3D filters with this frame's result, call it after mapTo3D
+void StereoPredictor::Update(const DataProcess& dataProcess)
+{
+	for (int i = 0; i < NUM_CAMERAS / 2; i++)
+	{
+		const ViewMask group = dataProcess.triangulation.groupViews[i];
+		for (int j = 0; j < Tracker::numMarkers; j++)
+		{
+			MarkerKalman3D& kf = filter[i][j];
+			const ViewMask seen = dataProcess.visibleViews[j] & group;
+			const cv::Point3d& p = dataProcess.MarkerPos3D[i][j];
+			bool triangulated = dataProcess.usedViews[i][j] != 0 && std::isfinite(p.z) && p.z > 0;
+			if (!kf.initialized)
+			{
+				if (triangulated)
+				{
+					kf.Init(p);
+				}
+				continue;
+			}
+			if (triangulated)
+			{
+				kf.Correct(p);
+			}
+			else if (seen)
+			{
+				// the view that still sees the marker constrains the point, the motion gives the depth
+				int camera = CountTrailingZeros(seen);
+				kf.CorrectView(dataProcess.cameras[camera], Tracker::currentPos[camera][j]);
+			}
+			else
+			{
+				int lost = std::numeric_limits<int>::max();
+				for (ViewMask rest = group; rest; rest &= rest - 1)
+				{
+					lost = std::min(lost, Tracker::lostFrames[CountTrailingZeros(rest)][j]);
+				}
+				if (lost > MAX_LOST_FRAMES_3D)
+				{
+					kf.initialized = false;
+				}
+			}
+		}
+	}
+}
+
+// This function predicts every marker for the next frame and projects the prediction
+// and its uncertainty into the cameras of the group
+void StereoPredictor::GuideTracker(const DataProcess& dataProcess)
+{
+	for (int c = 0; c < NUM_CAMERAS; c++)
+	{
+		for (int j = 0; j < Tracker::numMarkers; j++)
+		{
+			Tracker::guided[c][j] = false;
+		}
+	}
+	for (int i = 0; i < NUM_CAMERAS / 2; i++)
+	{
+		for (int j = 0; j < Tracker::numMarkers; j++)
+		{
+			MarkerKalman3D& kf = filter[i][j];
+			if (!kf.initialized)
+			{
+				continue;
+			}
+			kf.Predict();
+			cv::Point3d p = kf.Position();
+			cv::Matx33d cov = kf.PositionCov();
+			for (ViewMask rest = dataProcess.triangulation.groupViews[i]; rest; rest &= rest - 1)
+			{
+				const int c = CountTrailingZeros(rest);
+				const CameraModel& camera = dataProcess.cameras[c];
+				if (!camera.InFront(p))
+				{
+					continue;
+				}
+				cv::Point2d center = camera.Project(p);
+				cv::Matx23d J = camera.ProjectJacobian(p);
+				cv::Matx22d S = J * cov * J.t() + cv::Matx22d::eye() * (kf.pixelNoise * kf.pixelNoise);
+				cv::Size size = MarkerKalman::GateWindow(S(0, 0), S(1, 1));
+				Tracker::guidedCenter[c][j] = cv::Point2f(float(center.x), float(center.y));
+				Tracker::guidedWindow[c][j] = cv::Rect(cvRound(center.x) - size.width / 2, cvRound(center.y) - size.height / 2, size.width, size.height);
+				Tracker::guided[c][j] = true;
+			}
+		}
+	}
+}
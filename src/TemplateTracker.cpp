@@ -0,0 +1,95 @@
+// 颜色检测失败时，用灰度模板的归一化互相关在检测窗口中寻找marker
+#include "TemplateTracker.hpp"
+#include <cmath>
+
+
+MarkerTemplate::MarkerTemplate() :valid(false), usedThisFrame(false), age(0), patchNorm(0)
+{
+}
+
+// This function takes the patch around a colour detection, it is stored zero mean so the
+// cross term of the correlation needs no mean of the image
+void MarkerTemplate::Refresh(const cv::Mat& image, cv::Point position)
+{
+	cv::Rect area(position.x - TEMPLATE_DIM / 2, position.y - TEMPLATE_DIM / 2, TEMPLATE_DIM, TEMPLATE_DIM);
+	if ((area & cv::Rect(0, 0, image.cols, image.rows)) != area)
+	{
+		return;
+	}
+	cv::cvtColor(image(area), gray, CV_RGB2GRAY);
+	gray.convertTo(patch, CV_32F);
+	cv::Scalar mean = cv::mean(patch);
+	patch -= mean;
+	patchNorm = cv::norm(patch);
+	// a flat patch matches anything
+	valid = patchNorm > 1.0;
+	age = 0;
+}
+
+// This function finds the best match of the patch inside the window, within TEMPLATE_SEARCH_RADIUS of the prediction.
+// The image term of the normalization comes from integral images of the window, the cross term is
+// accumulated one template pixel at a time over a whole row of positions, a loop the compiler vectorizes.
+bool MarkerTemplate::Search(const cv::Mat& image, const cv::Rect& detectWindow, cv::Point2f predicted, cv::Point& position, double& score)
+{
+	score = -1;
+	const int half = TEMPLATE_SEARCH_RADIUS + TEMPLATE_DIM / 2;
+	const cv::Rect window = detectWindow & cv::Rect(cvRound(predicted.x) - half, cvRound(predicted.y) - half, 2 * half + 1, 2 * half + 1);
+	if (!valid || window.width < TEMPLATE_DIM || window.height < TEMPLATE_DIM)
+	{
+		return false;
+	}
+	cv::cvtColor(image(window), gray, CV_RGB2GRAY);
+	gray.convertTo(grayFloat, CV_32F);
+	cv::integral(gray, sum, sqsum, CV_64F);
+	const int positionsX = window.width - TEMPLATE_DIM + 1;
+	const int positionsY = window.height - TEMPLATE_DIM + 1;
+	const double n = TEMPLATE_DIM * TEMPLATE_DIM;
+	response.resize(positionsX);
+	cv::Point best;
+	for (int v = 0; v < positionsY; v++)
+	{
+		std::fill(response.begin(), response.end(), 0.0f);
+		float* out = &response[0];
+		for (int r = 0; r < TEMPLATE_DIM; r++)
+		{
+			const float* row = grayFloat.ptr<float>(v + r);
+			const float* t = patch.ptr<float>(r);
+			for (int c = 0; c < TEMPLATE_DIM; c++)
+			{
+				const float weight = t[c];
+				const float* in = row + c;
+				for (int u = 0; u < positionsX; u++)
+				{
+					out[u] += weight * in[u];
+				}
+			}
+		}
+		const double* s0 = sum.ptr<double>(v);
+		const double* s1 = sum.ptr<double>(v + TEMPLATE_DIM);
+		const double* q0 = sqsum.ptr<double>(v);
+		const double* q1 = sqsum.ptr<double>(v + TEMPLATE_DIM);
+		for (int u = 0; u < positionsX; u++)
+		{
+			const int e = u + TEMPLATE_DIM;
+			double s = s1[e] - s1[u] - s0[e] + s0[u];
+			double q = q1[e] - q1[u] - q0[e] + q0[u];
+			double variance = q - s * s / n;
+			if (variance <= 1.0)
+			{
+				continue;
+			}
+			double ncc = out[u] / (std::sqrt(variance) * patchNorm);
+			if (ncc > score)
+			{
+				score = ncc;
+				best = cv::Point(u, v);
+			}
+		}
+	}
+	if (score < TEMPLATE_MIN_SCORE)
+	{
+		return false;
+	}
+	position = cv::Point(window.x + best.x + TEMPLATE_DIM / 2, window.y + best.y + TEMPLATE_DIM / 2);
+	return true;
+}
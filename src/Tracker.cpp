@@ -1,11 +1,11 @@
 // 此文件用于初始化跟踪 
 #include "Tracker.hpp"
+#include "RigKernels.hpp"
 #include <algorithm>
 
 
 Tracker::Tracker():detectWindowDimX(120), detectWindowDimY(100),numCameras(4),threshold(100),TrackerAutoIntialized(false)
 {
-	cv::Point momentum[NUM_CAMERAS] = { cv::Point(0,0), cv::Point(0,0),cv::Point(0,0), cv::Point(0,0) };
 }
 
 
@@ -17,8 +17,30 @@ int Tracker::CorlorsChosen[3];
 bool Tracker::getColors = false;
 cv::Rect Tracker::calibration_region;
 cv::Mat Tracker::ReceivedImages[NUM_CAMERAS];
-cv::Point Tracker::currentPos[NUM_CAMERAS][NUM_MARKERS];
-cv::Point Tracker::previousPos[NUM_CAMERAS][NUM_MARKERS];
+cv::Point Tracker::currentPos[NUM_CAMERAS][MAX_MARKERS];
+cv::Point Tracker::previousPos[NUM_CAMERAS][MAX_MARKERS];
+MarkerKalman Tracker::motionModel[NUM_CAMERAS][MAX_MARKERS];
+cv::Rect Tracker::searchWindow[NUM_CAMERAS][MAX_MARKERS];
+int Tracker::lostFrames[NUM_CAMERAS][MAX_MARKERS];
+cv::Rect Tracker::lastSeenWindow[NUM_CAMERAS][MAX_MARKERS];
+bool Tracker::guided[NUM_CAMERAS][MAX_MARKERS];
+cv::Rect Tracker::guidedWindow[NUM_CAMERAS][MAX_MARKERS];
+cv::Point2f Tracker::guidedCenter[NUM_CAMERAS][MAX_MARKERS];
+BitMask Tracker::segmentedMask[NUM_CAMERAS];
+std::vector<cv::Rect> Tracker::segmentedRegions[NUM_CAMERAS];
+BlobScanner Tracker::scanner[NUM_CAMERAS];
+std::vector<cv::Point> Tracker::candidates[NUM_CAMERAS][MAX_MARKERS];
+MarkerAssignment Tracker::assignment[NUM_CAMERAS];
+MarkerTemplate Tracker::templates[NUM_CAMERAS][MAX_MARKERS];
+MarkerSet Tracker::markerSet;
+int Tracker::numMarkers = 6; // the default leg set of MarkerSet
+cv::Mat Tracker::hsvBuffer[NUM_CAMERAS];
+cv::Mat Tracker::rangeBuffer[NUM_CAMERAS];
+BitMask Tracker::allowedMask[NUM_CAMERAS];
+BackgroundModel Tracker::background[NUM_CAMERAS];
+ColourClassifier Tracker::colourClasses;
+cv::Mat Tracker::classLabels[NUM_CAMERAS];
+AdaptiveThreshold Tracker::thresholds[NUM_CAMERAS];
 
 // this function compare the areas of two contours
 bool compareContourAreas(std::vector<cv::Point> contour1, std::vector<cv::Point> contour2) {
@@ -29,8 +51,10 @@ bool compareContourAreas(std::vector<cv::Point> contour1, std::vector<cv::Point>
 
 // initialize with whole image, so detectPosition_Initial is (0, 0)
 // This function get the color of the marker
-void Tracker::Mouse_getColor(int event, int x, int y, int, void*)
+// The window passes its camera index as userdata, selections are taken from the frame without overlays.
+void Tracker::Mouse_getColor(int event, int x, int y, int, void* userdata)
 {
+	const int camera_index = userdata ? *static_cast<const int*>(userdata) : 0;
 	static cv::Point origin;
 	static cv::Rect selection;
 	switch (event)
@@ -45,7 +69,16 @@ void Tracker::Mouse_getColor(int event, int x, int y, int, void*)
 		selection.height = abs(y - origin.y);
 		std::cout << "Color area has been selected!" << std::endl;
 		std::cout << "Color has been selected" << std::endl;
-		image = image(selection);
+		selection &= cv::Rect(0, 0, ReceivedImages[camera_index].cols, ReceivedImages[camera_index].rows);
+		if (selection.area() <= 0)
+		{
+			break;
+		}
+		image = ReceivedImages[camera_index](selection).clone();
+		colourClasses.AddSamples(colourClasses.sampleMarker, image);
+		std::cout << "Colour samples of marker " << colourClasses.sampleMarker << " added from camera " << camera_index << ", select marker "
+			<< (colourClasses.sampleMarker + 1) % numMarkers << " next" << std::endl;
+		colourClasses.sampleMarker = (colourClasses.sampleMarker + 1) % numMarkers;
 		cv::Scalar meanScalar = cv::mean(image);
 		CorlorsChosen[0] = static_cast<int>(meanScalar.val[0]);
 		CorlorsChosen[1] = static_cast<int>(meanScalar.val[1]);
@@ -72,27 +105,36 @@ void Tracker::Mouse_getRegion(int event, int x, int y, int, void*)
 	}
 }
 
-void Tracker::ColorThresholding(int marker_index)
+// This function segments one region of a camera image into the shared mask of that camera.
+// Camera frames are RGB8 and go through the fused kernel, other formats through cvtColor and inRange.
+void Tracker::ColorThresholding(int camera_index, const cv::Rect& region)
 {
-	cv::cvtColor(detectWindow, detectWindow, CV_RGB2HSV);
-	cv::Mat rangeRes = cv::Mat::zeros(detectWindow.size(), CV_8UC1);
-	cv::inRange(detectWindow, cv::Scalar(MIN_H_RED, 160, 80), cv::Scalar(MAX_H_RED, 255, 255), rangeRes);
-	detectWindow = rangeRes;
-	/*for (int j = 0; j < detectWindow.rows; j++)
+	if (ColourIdentity(camera_index))
 	{
-		uchar*data = detectWindow.ptr<uchar>(j);
-		
-		for (int i = 0; i< detectWindow.cols; i++)
+		cv::Mat& labels = classLabels[camera_index];
+		if (labels.size() != ReceivedImages[camera_index].size())
 		{
-			
-			if ((abs(data[3 * i] - CorlorsChosen[0]) + abs(data[3 * i + 1] - CorlorsChosen[1]) +
-					abs(data[3 * i + 2] - CorlorsChosen[2]))< threshold)
-			{
-				data[3 * i] = data[3 * i + 1] = data[3 * i + 2] = 255;
-			}
-			else data[3 * i] = data[3 * i + 1] = data[3 * i + 2] = 0;
+			labels = cv::Mat::zeros(ReceivedImages[camera_index].size(), CV_8UC1);
 		}
-	}*/
+		ProductionRigKernels::Classify(ReceivedImages[camera_index], region, &colourClasses.lut[0], AllowedMask(camera_index), labels, segmentedMask[camera_index]);
+		return;
+	}
+	const HsvRange range = thresholds[camera_index].Range();
+	if (ReceivedImages[camera_index].type() == CV_8UC3)
+	{
+		ProductionRigKernels::Threshold(ReceivedImages[camera_index], region, range, AllowedMask(camera_index), segmentedMask[camera_index]);
+		return;
+	}
+	cv::Mat& hsv = hsvBuffer[camera_index];
+	cv::Mat& rangeRes = rangeBuffer[camera_index];
+	cv::cvtColor(ReceivedImages[camera_index](region), hsv, CV_RGB2HSV);
+	cv::inRange(hsv, cv::Scalar(range.hMin, range.sMin, range.vMin), cv::Scalar(range.hMax, range.sMax, range.vMax), rangeRes);
+	segmentedMask[camera_index].Pack(rangeRes, region.tl());
+	const BitMask* allowed = AllowedMask(camera_index);
+	if (allowed)
+	{
+		segmentedMask[camera_index].And(*allowed, region);
+	}
 }
 
 void Tracker::ColorThresholding()
@@ -103,7 +145,7 @@ void Tracker::ColorThresholding()
 	detectWindow_Initial = rangeRes;
 }
 
-// This function using contours to get all of six marker positions for one camera
+// This function using contours to get all of the marker positions for one camera
 bool Tracker:: getContoursAndMoment(int camera_index)
 {	
 	ColorThresholding();
@@ -111,8 +153,13 @@ bool Tracker:: getContoursAndMoment(int camera_index)
 	//cv::fastNlMeansDenoising(detectWindow_Initial, detectWindow_Initial);
 	//cv::Mat detectCopy = detectWindow_Initial.clone();
 	//cv::cvtColor(detectWindow_Initial, detectWindow_Initial, CV_BGRA2GRAY);
-	cv::Mat mask(9, 9, CV_8U, cv::Scalar(1));
-	cv::morphologyEx(detectWindow_Initial, detectWindow_Initial, cv::MORPH_CLOSE, mask);
+	BitMask initialMask;
+	cv::Rect wholeImage(0, 0, detectWindow_Initial.cols, detectWindow_Initial.rows);
+	initialMask.Create(detectWindow_Initial.cols, detectWindow_Initial.rows);
+	initialMask.Pack(detectWindow_Initial, cv::Point(0, 0));
+	initialMask.Close(wholeImage, 9, 9);
+	initialMask.Unpack(detectWindow_Initial, wholeImage);
+	FilterInitialImage(camera_index);
 	cv::namedWindow("detectwindow", 0);
 	cv::setMouseCallback("detectwindow", Mouse_getRegion, 0);
 	cv::imshow("detectwindow", detectWindow_Initial);
@@ -140,11 +187,11 @@ bool Tracker:: getContoursAndMoment(int camera_index)
 	std::sort(contours.begin(), contours.end(), compareContourAreas);
 	//contours = std::vector<std::vector<cv::Point>>(contours.begin(), contours.begin() + 6);
 	
-	if (contours.size() >= 6)
+	if (int(contours.size()) >= numMarkers)
 	{
 		//std::vector<std::vector<cv::Point>>::const_iterator it = contours.begin();
 	// 找到contour的boundingRect的中心
-		for (int i = 0; i < 6; i++)
+		for (int i = 0; i < numMarkers; i++)
 		{
 			std::cout << "contour size" << contours[i].size() << std::endl;
 			cv::Rect br = cv::boundingRect(contours[i]);
@@ -174,54 +221,106 @@ bool Tracker:: getContoursAndMoment(int camera_index)
 	}
 }
 
-// This function get the marker point for specific marker in a specific camera
+// This function get the marker point for specific marker in a specific camera,
+// the blobs are labeled straight from the packed mask of the camera (or of the marker's colour) inside the marker's window.
+// Every blob of the window is kept as a candidate for the assignment of the camera's markers.
 bool Tracker::getContoursAndMoment(int camera_index, int marker_index)
 {
-	ColorThresholding(camera_index);
-	//cv::Mat detectCopy = detectWindow_Initial.clone();
-	//cv::cvtColor(detectWindow_Initial, detectWindow_Initial, CV_BGRA2GRAY);
-	cv::Mat mask(5, 5, CV_8U, cv::Scalar(1));
-	cv::morphologyEx(detectWindow, detectWindow, cv::MORPH_CLOSE, mask);
-	std::vector<std::vector<cv::Point>>contours;
-	cv::findContours(detectWindow, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE);
-	//std::vector<std::vector<cv::Point>>::const_iterator itc = contours.begin();
-	// remove contours that are too small or large
-	//while (itc != contours.end())
-	//{
-	//	std::cout << itc->size() << std::endl;
-	//	//std::cout << "size: " << itc->size() << std::endl;
-	//	if (itc->size() < cmin || itc->size() > cmax)
-	//	{
-	//		itc = contours.erase(itc);
-	//	}
-	//	else itc++;
-	//}
-	/*cv::namedWindow("detectWindow", 0);
-	cv::imshow("detectWindow", detectCopy);
-	cv::waitKey(1);*/
-	std::sort(contours.begin(), contours.end(), compareContourAreas);
-	//contours = std::vector<std::vector<cv::Point>>(contours.begin(), contours.begin() + 1);
-	if (contours.size() >0)
-	{
-		cv::Rect br = cv::boundingRect(contours[0]);
-		int cx = br.x + br.width * 0.5; 
-		int cy = br.y + br.height * 0.5;
-		currentPos[camera_index][marker_index] = cv::Point(cx + detectPosition.x, cy + detectPosition.y);
-		
-		//std::vector<std::vector<cv::Point>>::const_iterator it = contours.begin();
-
-		//cv::Moments mom = cv::moments(cv::Mat(*it++));
-		//// 因为检测窗口不是全部画面，所以要加上检测窗口在全部画面的位置
-		//currentPos[camera_index][marker_index] = cv::Point(mom.m10 / mom.m00 + detectPosition_Initial.x, mom.m01 / mom.m00 + detectPosition_Initial.y);
-
+	MarkerMask(camera_index).ExtractBlobs(searchWindow[camera_index][marker_index], labeler, blobs);
+	std::vector<cv::Point>& found = candidates[camera_index][marker_index];
+	found.clear();
+	// 取面积最大的连通域
+	int largest = -1;
+	for (size_t k = 0; k < blobs.size(); k++)
+	{
+		found.push_back(blobs[k].Center());
+		if (largest < 0 || blobs[k].area > blobs[largest].area)
+		{
+			largest = int(k);
+		}
+	}
+	if (largest >= 0)
+	{
+		currentPos[camera_index][marker_index] = blobs[largest].Center();
 		return true;
 	}
 	else
 	{
-		// TODO: 如果使用颜色跟踪失败则需要使用其他跟踪方法
-		std::cout << "Contours numbers are wrong:  " << contours.size() << std::endl;
+		// 颜色跟踪失败时由TemplateSearch接手
+		std::cout << "Contours numbers are wrong:  " << blobs.size() << std::endl;
+		return false;
+	}
+}
+
+// where the marker is expected this frame: the centre projected from the stereo pair's 3D prediction when the window
+// is guided, else the motion model's prediction, or the last position before the model has started
+cv::Point2f Tracker::ExpectedCenter(int camera_index, int marker_index) const
+{
+	if (guided[camera_index][marker_index])
+	{
+		return guidedCenter[camera_index][marker_index];
+	}
+	const MarkerKalman& model = motionModel[camera_index][marker_index];
+	return model.initialized ? model.prediction : cv::Point2f(previousPos[camera_index][marker_index]);
+}
+
+// This function looks for the grayscale patch of the marker near its prediction, for frames where the colour blob vanished
+bool Tracker::TemplateSearch(int camera_index, int marker_index)
+{
+	MarkerTemplate& patch = templates[camera_index][marker_index];
+	cv::Point position;
+	double score;
+	if (!patch.Search(ReceivedImages[camera_index], searchWindow[camera_index][marker_index], ExpectedCenter(camera_index, marker_index), position, score))
+	{
 		return false;
 	}
+	patch.usedThisFrame = true;
+	currentPos[camera_index][marker_index] = position;
+	candidates[camera_index][marker_index].assign(1, position);
+	return true;
+}
+
+// This function follows the marker from its prediction with a few mean-shift steps over the colour mask:
+// a marker-sized kernel moves to the centroid of the marker pixels under it until it stops moving.
+// The result is trusted when the kernel holds nearly all marker pixels of its surroundings, i.e. it sits on
+// one compact blob. Otherwise the caller falls back to blob detection.
+bool Tracker::MeanShift(int camera_index, int marker_index)
+{
+	const cv::Rect& window = searchWindow[camera_index][marker_index];
+	const BitMask& mask = MarkerMask(camera_index);
+	const int kernelDim = 2 * MARKER_RADIUS + 1;
+	cv::Point2f center = ExpectedCenter(camera_index, marker_index);
+	cv::Rect kernel;
+	int mass = 0;
+	bool converged = false;
+	for (int k = 0; k < MEANSHIFT_ITERATIONS && !converged; k++)
+	{
+		kernel = cv::Rect(cvRound(center.x) - MARKER_RADIUS, cvRound(center.y) - MARKER_RADIUS, kernelDim, kernelDim) & window;
+		double sumX, sumY;
+		mass = mask.Moments(kernel, sumX, sumY);
+		if (mass == 0)
+		{
+			return false;
+		}
+		cv::Point2f next(float(sumX / mass), float(sumY / mass));
+		cv::Point2f shift = next - center;
+		converged = shift.x * shift.x + shift.y * shift.y < 0.25f;
+		center = next;
+	}
+	if (!converged)
+	{
+		return false;
+	}
+	double sumX, sumY;
+	cv::Rect surroundings(kernel.x - MEANSHIFT_MARGIN, kernel.y - MEANSHIFT_MARGIN, kernel.width + 2 * MEANSHIFT_MARGIN, kernel.height + 2 * MEANSHIFT_MARGIN);
+	int nearby = mask.Moments(surroundings & window, sumX, sumY);
+	if (mass < MEANSHIFT_MIN_CONFIDENCE * nearby)
+	{
+		return false;
+	}
+	currentPos[camera_index][marker_index] = cv::Point(cvRound(center.x), cvRound(center.y));
+	candidates[camera_index][marker_index].assign(1, currentPos[camera_index][marker_index]);
+	return true;
 }
 
 // 为了方便使用，初始化tracker时都应该实际使用ByDetection（使用其他的tracker都需要自行画出框图）
@@ -238,8 +337,8 @@ bool Tracker::InitTracker(TrackerType tracker_type)
 				detectWindow_Initial = ReceivedImages[i].clone();
 				// 如果把success放在前面，则success为false时，函数不会执行
 				success =  getContoursAndMoment(i) && success;
-				success =  RectifyMarkerPos(i) && success;
-				for (int j = 0; j < NUM_MARKERS; j++)
+				success =  (IdentifyByColour(i) || RectifyMarkerPos(i)) && success;
+				for (int j = 0; j < numMarkers; j++)
 				{
 					std::cout <<"Inital position: "<< i << j << currentPos[i][j] << std::endl;
 				}
@@ -247,6 +346,7 @@ bool Tracker::InitTracker(TrackerType tracker_type)
 			if (success)
 			{
 				std::cout << "Using Contours to InitTracker succeed" << std::endl;
+				InitMotionModels();
 
 				TrackerAutoIntialized = true;
 			}
@@ -257,7 +357,7 @@ bool Tracker::InitTracker(TrackerType tracker_type)
 	// see if data were correct
 	for (int i = 0; i < NUM_CAMERAS; i++)
 	{
-		for (int j = 0; j < NUM_MARKERS; j++)
+		for (int j = 0; j < numMarkers; j++)
 		{
 			cv::Point point = currentPos[i][j];
 			if (point.x <= 0 || point.y <= 0 || point.x>=2048 || point.y>=2048)
@@ -272,14 +372,14 @@ bool Tracker::InitTracker(TrackerType tracker_type)
 }
 
 // use bubble_sort to rectify Marker Position, from small to big
-// from top of image to bottom of image
+// from top of image to bottom of image. Only used at initialization without colour classes, later frames keep identities by assignment
 bool Tracker::RectifyMarkerPos(int camera_index)
 {
 	int i, j, change=1;
-	for (i = 0; i < NUM_MARKERS - 1 && change!=0; i++)
+	for (i = 0; i < numMarkers - 1 && change!=0; i++)
     {
         change=0;
-		for (j = 0; j < NUM_MARKERS - 1 - i; j++)
+		for (j = 0; j < numMarkers - 1 - i; j++)
 		{
 			if (currentPos[camera_index][j].y > currentPos[camera_index][j + 1].y)
 			{
@@ -291,9 +391,510 @@ bool Tracker::RectifyMarkerPos(int camera_index)
 	return true;
 }
 
-bool Tracker::FilterInitialImage()
+// This function replaces the marker set, the tracker has to be initialized again afterwards
+bool Tracker::LoadMarkerSet(const std::string& path)
+{
+	if (!markerSet.Load(path))
+	{
+		return false;
+	}
+	numMarkers = markerSet.size();
+	std::cout << "Tracking " << numMarkers << " markers of " << path << std::endl;
+	return true;
+}
+
+// the pixels segmentation looks at in one camera: the exclusions of the rig profile without the static clutter
+// of the background model once it is learned. NULL when neither applies or the profile was made for another image size
+const BitMask* Tracker::AllowedMask(int camera_index)
+{
+	const BackgroundModel& model = background[camera_index];
+	if (model.Ready() && model.allowed.size() == ReceivedImages[camera_index].size())
+	{
+		return &model.allowed;
+	}
+	const BitMask& mask = allowedMask[camera_index];
+	if (mask.empty() || mask.size() != ReceivedImages[camera_index].size())
+	{
+		return NULL;
+	}
+	return &mask;
+}
+
+// This function updates one stripe of the background model of a camera, before anything is drawn into the image
+void Tracker::UpdateBackground(int camera_index, const std::vector<cv::Rect>& candidates)
+{
+	const BitMask& mask = allowedMask[camera_index];
+	const BitMask* exclusions = mask.empty() || mask.size() != ReceivedImages[camera_index].size() ? NULL : &mask;
+	// the blobs initialization is looking at, the markers' windows and where lost markers were seen last
+	backgroundWindows.assign(candidates.begin(), candidates.end());
+	if (TrackerAutoIntialized)
+	{
+		for (int j = 0; j < numMarkers; j++)
+		{
+			backgroundWindows.push_back(searchWindow[camera_index][j]);
+			if (lostFrames[camera_index][j] > 0)
+			{
+				backgroundWindows.push_back(lastSeenWindow[camera_index][j]);
+			}
+		}
+	}
+	// the subject stands still before tracking starts, nothing becomes clutter until then
+	background[camera_index].Update(ReceivedImages[camera_index], exclusions, backgroundWindows.data(), int(backgroundWindows.size()),
+		TrackerAutoIntialized, thresholds[camera_index].Range());
+}
+
+// whether the markers of a camera are told apart by their colour classes instead of by position
+bool Tracker::ColourIdentity(int camera_index)
 {
-	//TODO: clearify images for tracker initialization
+	return colourClasses.Ready() && ReceivedImages[camera_index].type() == CV_8UC3;
+}
+
+// This function packs the pixels of the marker's own colour class in its window and closes them like the camera mask.
+// Closing with a k x k kernel reads k - 1 pixels beyond the window on each side, so that border is cleared too.
+void Tracker::BuildMarkerMask(int camera_index, int marker_index)
+{
+	if (!ColourIdentity(camera_index))
+	{
+		return;
+	}
+	const cv::Rect& window = searchWindow[camera_index][marker_index];
+	const cv::Mat& labels = classLabels[camera_index];
+	if (classMask.size() != labels.size())
+	{
+		classMask.Create(labels.cols, labels.rows);
+	}
+	const int kernel = 5, border = kernel - 1;
+	classMask.Clear(cv::Rect(window.x - border, window.y - border, window.width + 2 * border, window.height + 2 * border));
+	cv::compare(labels(window), cv::Scalar(marker_index + 1), classScratch, cv::CMP_EQ);
+	classMask.Pack(classScratch, window.tl());
+	classMask.Close(window, kernel, kernel);
+}
+
+// the mask the detectors of this tracker look at: the marker's own colour class or all marker colours of the camera
+const BitMask& Tracker::MarkerMask(int camera_index) const
+{
+	return ColourIdentity(camera_index) ? classMask : segmentedMask[camera_index];
+}
+
+// This function orders the initial marker positions of a camera by the colour class found around each of them.
+// It fails, leaving the positions alone, when some class is missing or found twice.
+bool Tracker::IdentifyByColour(int camera_index)
+{
+	if (!ColourIdentity(camera_index))
+	{
+		return false;
+	}
+	const cv::Mat& image = ReceivedImages[camera_index];
+	const int radius = 3; // contours drawn around the blobs must not reach the samples
+	std::vector<int> positionOf(numMarkers, -1);
+	for (int j = 0; j < numMarkers; j++)
+	{
+		std::vector<int> votes(numMarkers + 1, 0);
+		cv::Rect box = cv::Rect(currentPos[camera_index][j].x - radius, currentPos[camera_index][j].y - radius, 2 * radius + 1, 2 * radius + 1)
+			& cv::Rect(0, 0, image.cols, image.rows);
+		for (int y = box.y; y < box.y + box.height; y++)
+		{
+			const uchar* px = image.ptr<uchar>(y) + 3 * box.x;
+			for (int x = 0; x < box.width; x++, px += 3)
+			{
+				int label = colourClasses.Classify(px);
+				if (label > 0 && label <= numMarkers)
+				{
+					votes[label]++;
+				}
+			}
+		}
+		int best = int(std::max_element(votes.begin() + 1, votes.end()) - votes.begin());
+		if (votes[best] == 0 || positionOf[best - 1] >= 0)
+		{
+			std::cout << "Camera " << camera_index << " marker colours are ambiguous, ordering by position" << std::endl;
+			return false;
+		}
+		positionOf[best - 1] = j;
+	}
+	std::vector<cv::Point> found(currentPos[camera_index], currentPos[camera_index] + numMarkers);
+	for (int j = 0; j < numMarkers; j++)
+	{
+		currentPos[camera_index][j] = found[positionOf[j]];
+	}
+	return true;
+}
+
+// start every motion model at the initial marker positions
+void Tracker::InitMotionModels()
+{
+	for (int i = 0; i < NUM_CAMERAS; i++)
+	{
+		for (int j = 0; j < numMarkers; j++)
+		{
+			motionModel[i][j].Init(currentPos[i][j]);
+			searchWindow[i][j] = cv::Rect(currentPos[i][j].x - detectWindowDimX / 2, currentPos[i][j].y - detectWindowDimY / 2, detectWindowDimX, detectWindowDimY);
+			lastSeenWindow[i][j] = searchWindow[i][j];
+			lostFrames[i][j] = 0;
+			guided[i][j] = false;
+		}
+	}
+}
+
+// This function predicts where the marker is in this frame and returns the detect window around it,
+// clipped to the image. The window is empty if the prediction left the image.
+// A window placed by the 3D prediction of the stereo pair takes precedence over the 2D motion model.
+cv::Rect Tracker::PredictSearchWindow(int camera_index, int marker_index)
+{
+	MarkerKalman& model = motionModel[camera_index][marker_index];
+	cv::Rect window;
+	if (model.initialized)
+	{
+		model.Predict();
+		window = model.SearchWindow();
+	}
+	else
+	{
+		window = cv::Rect(previousPos[camera_index][marker_index].x - detectWindowDimX / 2,
+			previousPos[camera_index][marker_index].y - detectWindowDimY / 2, detectWindowDimX, detectWindowDimY);
+	}
+	if (guided[camera_index][marker_index])
+	{
+		window = guidedWindow[camera_index][marker_index];
+	}
+	window &= cv::Rect(0, 0, ReceivedImages[camera_index].cols, ReceivedImages[camera_index].rows);
+	searchWindow[camera_index][marker_index] = window;
+	return window;
+}
+
+// This function predicts the detect windows of all markers in all cameras, before the cameras are segmented
+void Tracker::PredictSearchWindows()
+{
+	for (int i = 0; i < NUM_CAMERAS; i++)
+	{
+		for (int j = 0; j < numMarkers; j++)
+		{
+			PredictSearchWindow(i, j);
+		}
+	}
+}
+
+// This function covers the union of the windows with disjoint rectangles.
+// The union is cut into horizontal bands at every window edge, the x intervals of each band are merged
+// and bands with the same interval are joined again, so every covered pixel belongs to exactly one rectangle.
+void Tracker::MergeWindows(const std::vector<cv::Rect>& windows, std::vector<cv::Rect>& regions)
+{
+	regions.clear();
+	std::vector<int> ys;
+	for (size_t k = 0; k < windows.size(); k++)
+	{
+		if (windows[k].area() > 0)
+		{
+			ys.push_back(windows[k].y);
+			ys.push_back(windows[k].y + windows[k].height);
+		}
+	}
+	std::sort(ys.begin(), ys.end());
+	ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+	std::vector<cv::Rect> open; // rectangles that may still grow downwards
+	std::vector<std::pair<int, int>> intervals;
+	for (size_t b = 0; b + 1 < ys.size(); b++)
+	{
+		int y0 = ys[b], y1 = ys[b + 1];
+		intervals.clear();
+		for (size_t k = 0; k < windows.size(); k++)
+		{
+			const cv::Rect& w = windows[k];
+			if (w.area() > 0 && w.y <= y0 && w.y + w.height >= y1)
+			{
+				intervals.push_back(std::make_pair(w.x, w.x + w.width));
+			}
+		}
+		std::sort(intervals.begin(), intervals.end());
+		std::vector<std::pair<int, int>> merged;
+		for (size_t k = 0; k < intervals.size(); k++)
+		{
+			if (!merged.empty() && intervals[k].first <= merged.back().second)
+			{
+				merged.back().second = std::max(merged.back().second, intervals[k].second);
+			}
+			else
+			{
+				merged.push_back(intervals[k]);
+			}
+		}
+		std::vector<cv::Rect> next;
+		for (size_t k = 0; k < merged.size(); k++)
+		{
+			bool extended = false;
+			for (size_t o = 0; o < open.size(); o++)
+			{
+				if (open[o].x == merged[k].first && open[o].x + open[o].width == merged[k].second && open[o].y + open[o].height == y0)
+				{
+					open[o].height += y1 - y0;
+					next.push_back(open[o]);
+					open[o].width = 0; // taken
+					extended = true;
+					break;
+				}
+			}
+			if (!extended)
+			{
+				next.push_back(cv::Rect(merged[k].first, y0, merged[k].second - merged[k].first, y1 - y0));
+			}
+		}
+		for (size_t o = 0; o < open.size(); o++)
+		{
+			if (open[o].width > 0)
+			{
+				regions.push_back(open[o]);
+			}
+		}
+		open.swap(next);
+	}
+	regions.insert(regions.end(), open.begin(), open.end());
+}
+
+// This function segments every pixel covered by the detect windows of one camera exactly once.
+// The markers of one camera then look for their blob in the same mask.
+void Tracker::SegmentCamera(int camera_index)
+{
+	const cv::Mat& image = ReceivedImages[camera_index];
+	BitMask& segmented = segmentedMask[camera_index];
+	std::vector<cv::Rect>& regions = segmentedRegions[camera_index];
+	if (segmented.size() != image.size())
+	{
+		segmented.Create(image.cols, image.rows);
+		regions.clear();
+	}
+	// only the regions of the last frame hold old data
+	for (size_t k = 0; k < regions.size(); k++)
+	{
+		segmented.Clear(regions[k]);
+	}
+	std::vector<cv::Rect> windows(searchWindow[camera_index], searchWindow[camera_index] + numMarkers);
+	MergeWindows(windows, regions);
+	for (size_t k = 0; k < regions.size(); k++)
+	{
+		ColorThresholding(camera_index, regions[k]);
+	}
+	// closing reads the neighbourhood of a region, so blobs on the border between two regions are closed like the others
+	for (size_t k = 0; k < regions.size(); k++)
+	{
+		segmented.Close(regions[k], 5, 5);
+	}
+}
+
+// This function feeds this frame's detection to the motion model of the marker.
+// A missed marker keeps following the prediction so the window can catch it again,
+// the 3D prediction carries what the other view of the pair still sees.
+void Tracker::UpdateMotionModel(int camera_index, int marker_index, bool found)
+{
+	MarkerKalman& model = motionModel[camera_index][marker_index];
+	if (found)
+	{
+		if (model.initialized)
+		{
+			model.Correct(currentPos[camera_index][marker_index]);
+		}
+		lostFrames[camera_index][marker_index] = 0;
+		lastSeenWindow[camera_index][marker_index] = searchWindow[camera_index][marker_index];
+		return;
+	}
+	if (guided[camera_index][marker_index])
+	{
+		cv::Point2f center = guidedCenter[camera_index][marker_index];
+		currentPos[camera_index][marker_index] = cv::Point(cvRound(center.x), cvRound(center.y));
+	}
+	else if (model.initialized)
+	{
+		currentPos[camera_index][marker_index] = cv::Point(cvRound(model.prediction.x), cvRound(model.prediction.y));
+	}
+	lostFrames[camera_index][marker_index]++;
+}
+
+// This function assigns the detections of one camera to its markers with the least total cost.
+// A detection is a candidate for a marker when it lies inside the gate around the marker's prediction,
+// the gate is half the size of the detect window, so it follows the uncertainty of the motion model.
+// match[marker] is the detection of the marker or -1.
+// When owner is given, detection k may only go to marker (*owner)[k].
+void Tracker::AssignDetections(int camera_index, const std::vector<cv::Point2f>& detections, const BlobGrid* grid, const std::vector<int>* owner, std::vector<int>& match)
+{
+	std::vector<AssignmentEdge> edges;
+	std::vector<int> nearby;
+	for (int j = 0; j < numMarkers; j++)
+	{
+		const cv::Rect& window = searchWindow[camera_index][j];
+		if (window.area() <= 0)
+		{
+			continue;
+		}
+		cv::Point2f predicted(window.x + window.width * 0.5f, window.y + window.height * 0.5f);
+		float gate = 0.5f * std::max(window.width, window.height);
+		if (grid)
+		{
+			grid->Within(predicted, gate, nearby);
+		}
+		else
+		{
+			nearby.resize(detections.size());
+			for (size_t k = 0; k < detections.size(); k++)
+			{
+				nearby[k] = int(k);
+			}
+		}
+		for (size_t n = 0; n < nearby.size(); n++)
+		{
+			cv::Point2f d = detections[nearby[n]] - predicted;
+			double distance = d.x * d.x + d.y * d.y;
+			if (distance <= gate * gate && (!owner || (*owner)[nearby[n]] == j))
+			{
+				AssignmentEdge edge = { j, nearby[n], distance / (gate * gate) };
+				edges.push_back(edge);
+			}
+		}
+	}
+	assignment[camera_index].Solve(numMarkers, int(detections.size()), edges, match);
+}
+
+// This function pools the blobs the markers of one camera found in their windows and assigns them to the markers.
+// Overlapping windows see the same blob, blobs closer than a marker radius are taken as one.
+void Tracker::AssignMarkers(int camera_index)
+{
+	// with colour classes a blob found in the window of a marker has that marker's colour, so it stays its own
+	const bool byColour = ColourIdentity(camera_index);
+	std::vector<cv::Point2f> detections;
+	std::vector<int> owner;
+	for (int j = 0; j < numMarkers; j++)
+	{
+		const std::vector<cv::Point>& found = candidates[camera_index][j];
+		for (size_t k = 0; k < found.size(); k++)
+		{
+			cv::Point2f position(found[k]);
+			bool seen = false;
+			for (size_t d = 0; d < detections.size() && !seen; d++)
+			{
+				cv::Point2f diff = detections[d] - position;
+				seen = (!byColour || owner[d] == j) && diff.x * diff.x + diff.y * diff.y < MARKER_RADIUS * MARKER_RADIUS;
+			}
+			if (!seen)
+			{
+				detections.push_back(position);
+				owner.push_back(j);
+			}
+		}
+		candidates[camera_index][j].clear();
+	}
+	std::vector<int> match;
+	AssignDetections(camera_index, detections, NULL, byColour ? &owner : NULL, match);
+	for (int j = 0; j < numMarkers; j++)
+	{
+		if (match[j] >= 0)
+		{
+			currentPos[camera_index][j] = cv::Point(cvRound(detections[match[j]].x), cvRound(detections[match[j]].y));
+		}
+		UpdateMotionModel(camera_index, j, match[j] >= 0);
+		// the patch follows the look of the marker from colour detections only, never from its own matches
+		MarkerTemplate& patch = templates[camera_index][j];
+		if (match[j] >= 0 && !patch.usedThisFrame && (!patch.valid || ++patch.age >= TEMPLATE_REFRESH_FRAMES))
+		{
+			patch.Refresh(ReceivedImages[camera_index], currentPos[camera_index][j]);
+		}
+		patch.usedThisFrame = false;
+	}
+	SampleColours(camera_index, match);
+	thresholds[camera_index].Derive();
+}
+
+// This function counts the colours at the markers found this frame and around them in their windows
+// for the adaptive range of the camera. The window is sampled on every other row and column.
+void Tracker::SampleColours(int camera_index, const std::vector<int>& match)
+{
+	const cv::Mat& image = ReceivedImages[camera_index];
+	if (image.type() != CV_8UC3 || ColourIdentity(camera_index))
+	{
+		return;
+	}
+	const HsvTables& tables = HsvTables::Get();
+	const cv::Rect wholeImage(0, 0, image.cols, image.rows);
+	AdaptiveThreshold& threshold = thresholds[camera_index];
+	const int core = 3; // well inside the smallest marker
+	int h, s, v;
+	for (int j = 0; j < numMarkers; j++)
+	{
+		if (match[j] < 0)
+		{
+			continue;
+		}
+		const cv::Point& at = currentPos[camera_index][j];
+		cv::Rect box = cv::Rect(at.x - core, at.y - core, 2 * core + 1, 2 * core + 1) & wholeImage;
+		for (int y = box.y; y < box.y + box.height; y++)
+		{
+			const uchar* px = image.ptr<uchar>(y) + 3 * box.x;
+			for (int x = 0; x < box.width; x++, px += 3)
+			{
+				ProductionRigKernels::Hsv(px, tables, h, s, v);
+				threshold.AddMarker(h, s, v);
+			}
+		}
+		const cv::Rect window = searchWindow[camera_index][j] & wholeImage;
+		for (int y = window.y; y < window.y + window.height; y += 2)
+		{
+			for (int x = window.x; x < window.x + window.width; x += 2)
+			{
+				bool nearMarker = false;
+				for (int k = 0; k < numMarkers && !nearMarker; k++)
+				{
+					const cv::Point& other = currentPos[camera_index][k];
+					nearMarker = match[k] >= 0 && std::abs(x - other.x) <= MARKER_RADIUS && std::abs(y - other.y) <= MARKER_RADIUS;
+				}
+				if (!nearMarker)
+				{
+					ProductionRigKernels::Hsv(image.ptr<uchar>(y) + 3 * x, tables, h, s, v);
+					threshold.AddBackground(h, s, v);
+				}
+			}
+		}
+	}
+}
+
+// This function scans the whole image of one camera once and assigns the blobs around the predictions
+// to the markers, the blobs near a prediction are looked up in the grid of blob centroids
+void Tracker::ScanCamera(int camera_index)
+{
+	BlobScanner& scan = scanner[camera_index];
+	scan.range = thresholds[camera_index].Range();
+	scan.Scan(ReceivedImages[camera_index], AllowedMask(camera_index));
+	std::vector<int> match;
+	AssignDetections(camera_index, scan.grid.centers, &scan.grid, NULL, match);
+	for (int j = 0; j < numMarkers; j++)
+	{
+		if (match[j] >= 0)
+		{
+			currentPos[camera_index][j] = scan.blobs[match[j]].Center();
+		}
+		UpdateMotionModel(camera_index, j, match[j] >= 0);
+	}
+	SampleColours(camera_index, match);
+	thresholds[camera_index].Derive();
+}
+
+// This function clears the initial colour mask where no marker can be: excluded regions and static clutter,
+// and, if anything moved since start-up, everything farther than a marker radius from recent motion
+bool Tracker::FilterInitialImage(int camera_index)
+{
+	const cv::Rect wholeImage(0, 0, detectWindow_Initial.cols, detectWindow_Initial.rows);
+	const BitMask* allowed = AllowedMask(camera_index);
+	if (allowed)
+	{
+		cv::Mat keep;
+		allowed->Unpack(keep, wholeImage);
+		cv::bitwise_and(detectWindow_Initial, keep, detectWindow_Initial);
+	}
+	const BackgroundModel& model = background[camera_index];
+	if (model.Ready() && model.SawMotion() && model.moved.size() == detectWindow_Initial.size())
+	{
+		cv::Mat moving;
+		model.moved.Unpack(moving, wholeImage);
+		cv::dilate(moving, moving, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2 * MARKER_RADIUS + 1, 2 * MARKER_RADIUS + 1)));
+		cv::bitwise_and(detectWindow_Initial, moving, detectWindow_Initial);
+	}
 	return true;
 }
 
@@ -306,7 +907,6 @@ DWORD WINAPI UpdateTracker(LPVOID lpParam)
 	Tracker* trackerPtr = para.trackerPtr;
 	TrackerType tracker_type = para.tracker_type;
 	bool success = true;
-	cv::Point detectRegionPosition;
 
 	switch (tracker_type)
 	{
@@ -314,28 +914,43 @@ DWORD WINAPI UpdateTracker(LPVOID lpParam)
 		// using contours to update tracker 
 		for (int i = 0; i < NUM_CAMERAS; i++)
 		{
-			// use previous position of marker as the center of detectPosition_Initial
-			// and move detectPosition_Initial to left_upper corner
-			(*trackerPtr).detectPosition = (*trackerPtr).previousPos[i][marker_index] + (*trackerPtr).momentum[i] - cv::Point(int((*trackerPtr).detectWindowDimX*0.5), int((*trackerPtr).detectWindowDimY * 0.5));
-			
-			cv::Rect detectRect((*trackerPtr).detectPosition.x, (*trackerPtr).detectPosition.y, (*trackerPtr).detectWindowDimX, (*trackerPtr).detectWindowDimY);
-			(*trackerPtr).detectWindow = (*trackerPtr).ReceivedImages[i](detectRect).clone(); // 
-			success = (*trackerPtr).getContoursAndMoment(i, marker_index) && success;
-			(*trackerPtr).momentum[i] = weight*((*trackerPtr).currentPos[i][marker_index] - (*trackerPtr).previousPos[i][marker_index]);
+			// the window was predicted and segmented with the other markers of this camera
+			cv::Rect detectRect = (*trackerPtr).searchWindow[i][marker_index];
+			bool found = false;
+			if (detectRect.area() > 0)
+			{
+				(*trackerPtr).detectPosition = detectRect.tl();
+				(*trackerPtr).BuildMarkerMask(i, marker_index);
+				found = (*trackerPtr).getContoursAndMoment(i, marker_index) || (*trackerPtr).TemplateSearch(i, marker_index);
+			}
+			else
+			{
+				(*trackerPtr).candidates[i][marker_index].clear();
+			}
+			// the markers of each camera are assigned together once all threads are done
+			success = found && success;
 		}
 		break;
 	case CV_KCF:
 		break;
 	case ByColor:
-		// using contours to update tracker 
+		// mean shift from the prediction, the blobs of the window are only extracted when it loses confidence
 		for (int i = 0; i < NUM_CAMERAS; i++)
 		{
-			// use previous position of marker as the center of detectPosition_Initial
-			// and move detectPosition_Initial to left_upper corner
-			(*trackerPtr).detectPosition = (*trackerPtr).previousPos[i][marker_index]+(*trackerPtr).momentum[i] - cv::Point(int((*trackerPtr).detectWindowDimX * 0.5), int((*trackerPtr).detectWindowDimY * 0.5));
-			cv::Rect detectRect((*trackerPtr).detectPosition.x, (*trackerPtr).detectPosition.y, (*trackerPtr).detectWindowDimX, (*trackerPtr).detectWindowDimY);
-			(*trackerPtr).detectWindow = (*trackerPtr).ReceivedImages[i](detectRect).clone(); // 
-			(*trackerPtr).momentum[i] = weight * ((*trackerPtr).currentPos[i][marker_index] - (*trackerPtr).previousPos[i][marker_index]);
+			cv::Rect detectRect = (*trackerPtr).searchWindow[i][marker_index];
+			bool found = false;
+			if (detectRect.area() > 0)
+			{
+				(*trackerPtr).detectPosition = detectRect.tl();
+				(*trackerPtr).BuildMarkerMask(i, marker_index);
+				found = (*trackerPtr).MeanShift(i, marker_index) || (*trackerPtr).getContoursAndMoment(i, marker_index)
+					|| (*trackerPtr).TemplateSearch(i, marker_index);
+			}
+			else
+			{
+				(*trackerPtr).candidates[i][marker_index].clear();
+			}
+			success = found && success;
 		}
 		break;
 	default:
@@ -344,3 +959,21 @@ DWORD WINAPI UpdateTracker(LPVOID lpParam)
 
 	return success;
 }
+
+#if defined (_WIN32)
+DWORD WINAPI UpdateSegmentation(LPVOID lpParam)
+{
+#endif
+	SegmentationParameters para = *((SegmentationParameters*)lpParam);
+	(*para.trackerPtr).SegmentCamera(para.camera_index);
+	return true;
+}
+
+#if defined (_WIN32)
+DWORD WINAPI UpdateBlobScan(LPVOID lpParam)
+{
+#endif
+	SegmentationParameters para = *((SegmentationParameters*)lpParam);
+	(*para.trackerPtr).ScanCamera(para.camera_index);
+	return true;
+}
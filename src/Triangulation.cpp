@@ -0,0 +1,268 @@
+// 多视角三角化：每个marker由看到它的所有相机加权求解（线性最小二乘加高斯牛顿优化），剔除误差过大的视角；离线数据可按列批量求解
+#include "Triangulation.h"
+#include <cmath>
+#include <limits>
+
+
+void ObservationBatch::Clear()
+{
+	views.clear();
+	for (int c = 0; c < NUM_CAMERAS; c++)
+	{
+		x[c].clear();
+		y[c].clear();
+		weight[c].clear();
+	}
+}
+
+void ObservationBatch::Reserve(size_t count)
+{
+	views.reserve(count);
+	for (int c = 0; c < NUM_CAMERAS; c++)
+	{
+		x[c].reserve(count);
+		y[c].reserve(count);
+		weight[c].reserve(count);
+	}
+}
+
+// This function appends one point, sensor and pointWeight are read for the cameras of pointViews only
+void ObservationBatch::Add(ViewMask pointViews, const cv::Point2d sensor[], const double pointWeight[])
+{
+	views.push_back(pointViews);
+	for (int c = 0; c < NUM_CAMERAS; c++)
+	{
+		const bool seen = (pointViews >> c) & 1;
+		x[c].push_back(seen ? sensor[c].x : 0.0);
+		y[c].push_back(seen ? sensor[c].y : 0.0);
+		weight[c].push_back(seen ? pointWeight[c] : 0.0);
+	}
+}
+
+void BatchPoints::Resize(size_t count)
+{
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	residual.resize(count);
+	inliers.resize(count);
+}
+
+// This function adds the two equations of one view, u * P3 - P1 and v * P3 - P2, to the normal equations
+// of the inhomogeneous point. m is the symmetric 3x3 matrix (xx, xy, xz, yy, yz, zz), g the right-hand side.
+static inline void AddView(const cv::Matx34d& P, double u, double v, double weight, double m[6], double g[3])
+{
+	for (int row = 0; row < 2; row++)
+	{
+		const double image = row == 0 ? u : v;
+		const double a0 = image * P(2, 0) - P(row, 0);
+		const double a1 = image * P(2, 1) - P(row, 1);
+		const double a2 = image * P(2, 2) - P(row, 2);
+		const double a3 = image * P(2, 3) - P(row, 3);
+		m[0] += weight * a0 * a0; m[1] += weight * a0 * a1; m[2] += weight * a0 * a2;
+		m[3] += weight * a1 * a1; m[4] += weight * a1 * a2; m[5] += weight * a2 * a2;
+		g[0] -= weight * a0 * a3; g[1] -= weight * a1 * a3; g[2] -= weight * a2 * a3;
+	}
+}
+
+// This function solves the symmetric 3x3 system m x = g by cofactors
+static inline void SolveSymmetric(const double m[6], const double g[3], double x[3])
+{
+	const double c00 = m[3] * m[5] - m[4] * m[4];
+	const double c01 = m[2] * m[4] - m[1] * m[5];
+	const double c02 = m[1] * m[4] - m[2] * m[3];
+	const double c11 = m[0] * m[5] - m[2] * m[2];
+	const double c12 = m[1] * m[2] - m[0] * m[4];
+	const double c22 = m[0] * m[3] - m[1] * m[1];
+	const double inverse = 1.0 / (m[0] * c00 + m[1] * c01 + m[2] * c02);
+	x[0] = (c00 * g[0] + c01 * g[1] + c02 * g[2]) * inverse;
+	x[1] = (c01 * g[0] + c11 * g[1] + c12 * g[2]) * inverse;
+	x[2] = (c02 * g[0] + c12 * g[1] + c22 * g[2]) * inverse;
+}
+
+// This function adds the reprojection residual of one view and its derivative to the Gauss-Newton equations,
+// and returns the squared residual
+static inline double AddResidual(const cv::Matx34d& P, double u, double v, double weight, const double X[3], double h[6], double g[3])
+{
+	const double w = P(2, 0) * X[0] + P(2, 1) * X[1] + P(2, 2) * X[2] + P(2, 3);
+	const double pu = (P(0, 0) * X[0] + P(0, 1) * X[1] + P(0, 2) * X[2] + P(0, 3)) / w;
+	const double pv = (P(1, 0) * X[0] + P(1, 1) * X[1] + P(1, 2) * X[2] + P(1, 3)) / w;
+	const double eu = pu - u, ev = pv - v;
+	double ju[3], jv[3];
+	for (int c = 0; c < 3; c++)
+	{
+		ju[c] = (P(0, c) - pu * P(2, c)) / w;
+		jv[c] = (P(1, c) - pv * P(2, c)) / w;
+	}
+	h[0] += weight * (ju[0] * ju[0] + jv[0] * jv[0]); h[1] += weight * (ju[0] * ju[1] + jv[0] * jv[1]); h[2] += weight * (ju[0] * ju[2] + jv[0] * jv[2]);
+	h[3] += weight * (ju[1] * ju[1] + jv[1] * jv[1]); h[4] += weight * (ju[1] * ju[2] + jv[1] * jv[2]); h[5] += weight * (ju[2] * ju[2] + jv[2] * jv[2]);
+	g[0] -= weight * (ju[0] * eu + jv[0] * ev); g[1] -= weight * (ju[1] * eu + jv[1] * ev); g[2] -= weight * (ju[2] * eu + jv[2] * ev);
+	return eu * eu + ev * ev;
+}
+
+
+MultiViewTriangulator::MultiViewTriangulator() :numCameras(0), numGroups(0)
+{
+}
+
+void MultiViewTriangulator::SetCameras(const CameraModel cameras[], int numCameras_)
+{
+	numCameras = std::min(numCameras_, NUM_CAMERAS);
+	numGroups = 0;
+	std::fill(groupViews, groupViews + NUM_CAMERAS, ViewMask(0));
+	for (int c = 0; c < numCameras; c++)
+	{
+		const CameraModel& camera = cameras[c];
+		const cv::Matx33d KR = camera.K * camera.R;
+		const cv::Vec3d Kt = camera.K * camera.t;
+		projection[c] = cv::Matx34d(KR(0, 0), KR(0, 1), KR(0, 2), Kt[0],
+			KR(1, 0), KR(1, 1), KR(1, 2), Kt[1],
+			KR(2, 0), KR(2, 1), KR(2, 2), Kt[2]);
+		if (camera.pair >= 0 && camera.pair < NUM_CAMERAS)
+		{
+			groupViews[camera.pair] |= ViewMask(1) << c;
+			numGroups = std::max(numGroups, camera.pair + 1);
+		}
+	}
+}
+
+// This function solves the point seen at sensor[c] by every camera c of views. weight[c] is 1 / variance of the view.
+// It returns false when the last two views disagree, point and residual are set anyway, or when fewer than two views
+// are given, then point is NaN, inliers 0 and residual 0.
+bool MultiViewTriangulator::Solve(const cv::Point2d sensor[], const double weight[], ViewMask views, cv::Point3d& point, ViewMask& inliers, double& residual) const
+{
+	ViewMask active = views;
+	while (CountViews(active) >= 2)
+	{
+		double m[6] = { 0, 0, 0, 0, 0, 0 }, g[3] = { 0, 0, 0 }, X[3];
+		for (ViewMask rest = active; rest; rest &= rest - 1)
+		{
+			const int c = CountTrailingZeros(rest);
+			AddView(projection[c], sensor[c].x, sensor[c].y, weight[c], m, g);
+		}
+		SolveSymmetric(m, g, X);
+		for (int iteration = 0; iteration < MULTIVIEW_REFINE_ITERATIONS; iteration++)
+		{
+			double h[6] = { 0, 0, 0, 0, 0, 0 }, gn[3] = { 0, 0, 0 }, step[3];
+			for (ViewMask rest = active; rest; rest &= rest - 1)
+			{
+				const int c = CountTrailingZeros(rest);
+				AddResidual(projection[c], sensor[c].x, sensor[c].y, weight[c], X, h, gn);
+			}
+			SolveSymmetric(h, gn, step);
+			X[0] += step[0];
+			X[1] += step[1];
+			X[2] += step[2];
+		}
+		// the view with the largest reprojection error
+		double total = 0, worstError = -1;
+		int worst = -1;
+		for (ViewMask rest = active; rest; rest &= rest - 1)
+		{
+			const int c = CountTrailingZeros(rest);
+			double h[6] = { 0, 0, 0, 0, 0, 0 }, gn[3] = { 0, 0, 0 };
+			const double error = AddResidual(projection[c], sensor[c].x, sensor[c].y, 1.0, X, h, gn);
+			total += error;
+			if (error > worstError)
+			{
+				worstError = error;
+				worst = c;
+			}
+		}
+		const bool agree = worstError <= MULTIVIEW_MAX_RESIDUAL * MULTIVIEW_MAX_RESIDUAL;
+		if (agree || CountViews(active) == 2)
+		{
+			point = cv::Point3d(X[0], X[1], X[2]);
+			inliers = active;
+			residual = std::sqrt(total / (2 * CountViews(active)));
+			return agree;
+		}
+		active &= ~(ViewMask(1) << worst);
+	}
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	point = cv::Point3d(nan, nan, nan);
+	inliers = 0;
+	residual = 0;
+	return false;
+}
+
+// This function triangulates every marker of every group of one live frame from the undistorted sensor positions.
+// visible[j] holds the cameras that detected marker j this frame. A marker seen by fewer than two cameras of its group
+// is solved from the predicted positions of all of them, so the 3D point keeps following, and used is 0 for it.
+// residual is the reprojection error of the point scaled to millimetre at its distance from the first camera that solved it.
+void MultiViewTriangulator::TriangulateFrame(const CameraModel cameras[], const cv::Point2d sensor[][MAX_MARKERS], const ViewMask visible[], int numMarkers,
+	cv::Point3d out[][MAX_MARKERS], ViewMask used[][MAX_MARKERS], double residual[][MAX_MARKERS]) const
+{
+	cv::Point2d view[NUM_CAMERAS];
+	double weight[NUM_CAMERAS];
+	for (int c = 0; c < numCameras; c++)
+	{
+		// the centroid noise is about one image pixel, a sensor pixel less with binning
+		weight[c] = 1.0 / (cameras[c].binning * cameras[c].binning);
+	}
+	for (int j = 0; j < numMarkers; j++)
+	{
+		for (int c = 0; c < numCameras; c++)
+		{
+			view[c] = sensor[c][j];
+		}
+		for (int g = 0; g < numGroups && g < NUM_CAMERAS / 2; g++)
+		{
+			ViewMask views = visible[j] & groupViews[g];
+			const bool measured = CountViews(views) >= 2;
+			if (!measured)
+			{
+				views = groupViews[g];
+			}
+			ViewMask inliers;
+			double error;
+			bool agree = Solve(view, weight, views, out[g][j], inliers, error);
+			used[g][j] = measured && agree ? inliers : 0;
+			if (!inliers)
+			{
+				// fewer than two calibrated cameras in the group, the point is NaN
+				residual[g][j] = error;
+				continue;
+			}
+			const CameraModel& first = cameras[CountTrailingZeros(inliers)];
+			const cv::Vec3d local = first.R * cv::Vec3d(out[g][j].x, out[g][j].y, out[g][j].z) + first.t;
+			residual[g][j] = error * std::abs(local[2]) / first.K(0, 0);
+		}
+	}
+}
+
+// This function solves every point of an offline batch, e.g. all board corners of a calibration recording, and
+// returns the number of points whose views agree. The arrays are read in order, nothing is allocated per point.
+int MultiViewTriangulator::TriangulateBatch(const ObservationBatch& batch, BatchPoints& points) const
+{
+	const size_t count = batch.size();
+	points.Resize(count);
+	const double* x[NUM_CAMERAS];
+	const double* y[NUM_CAMERAS];
+	const double* w[NUM_CAMERAS];
+	for (int c = 0; c < NUM_CAMERAS; c++)
+	{
+		x[c] = batch.x[c].data();
+		y[c] = batch.y[c].data();
+		w[c] = batch.weight[c].data();
+	}
+	cv::Point2d sensor[NUM_CAMERAS];
+	double weight[NUM_CAMERAS];
+	int solved = 0;
+	for (size_t k = 0; k < count; k++)
+	{
+		const ViewMask views = batch.views[k];
+		for (ViewMask rest = views; rest; rest &= rest - 1)
+		{
+			const int c = CountTrailingZeros(rest);
+			sensor[c] = cv::Point2d(x[c][k], y[c][k]);
+			weight[c] = w[c][k];
+		}
+		cv::Point3d point;
+		solved += Solve(sensor, weight, views, point, points.inliers[k], points.residual[k]) ? 1 : 0;
+		points.x[k] = point.x;
+		points.y[k] = point.y;
+		points.z[k] = point.z;
+	}
+	return solved;
+}
@@ -0,0 +1,201 @@
+// 在后台线程中用地面上的棋盘格估计世界坐标系，多帧平均，不阻塞跟踪
+#include "WorldFrameWorker.h"
+
+// corners 0, 2 and 7 span the board: the origin, the end of the first row and the middle of the last row
+const int WORLD_BOARD_CORNERS[3] = { 0, 2, 7 };
+
+
+WorldFrameWorker::WorldFrameWorker(const CameraModel cameras_[], int numCameras_) :running(true), requested(false), ready(false), converged(false)
+{
+	numCameras = std::min(numCameras_, NUM_CAMERAS);
+	std::copy(cameras_, cameras_ + numCameras, cameras);
+	triangulation.SetCameras(cameras, numCameras);
+	for (int p = 0; p < NUM_CAMERAS / 2; p++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			cornerSum[p][k] = Vec3();
+		}
+	}
+	worker = std::thread(&WorldFrameWorker::Run, this);
+}
+
+
+WorldFrameWorker::~WorldFrameWorker()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		running = false;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+// This function is called once per frame before anything is drawn into the images. It copies a new estimate into
+// frames and returns true when there is one, and hands the frames to the worker when it is idle.
+// If the worker holds the lock the frame loop skips this frame instead of waiting.
+bool WorldFrameWorker::Update(const cv::Mat images[], WorldFrame frames[])
+{
+	std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+	if (!guard.owns_lock())
+	{
+		return false;
+	}
+	bool updated = ready;
+	if (ready)
+	{
+		std::copy(published, published + NUM_CAMERAS / 2, frames);
+		ready = false;
+	}
+	if (!requested && !converged)
+	{
+		// copyTo reuses the buffers, the camera images are overwritten by the next acquisition
+		for (int c = 0; c < numCameras; c++)
+		{
+			images[c].copyTo(pending[c]);
+		}
+		requested = true;
+		guard.unlock();
+		wake.notify_one();
+	}
+	return updated;
+}
+
+void WorldFrameWorker::Run()
+{
+	cv::Mat frames[NUM_CAMERAS];
+	std::vector<cv::Point2d> corners[NUM_CAMERAS];
+	std::unique_lock<std::mutex> guard(lock);
+	while (running)
+	{
+		if (!requested)
+		{
+			wake.wait(guard);
+			continue;
+		}
+		// detect without the lock so the frame loop can keep going
+		for (int c = 0; c < numCameras; c++)
+		{
+			cv::swap(frames[c], pending[c]);
+		}
+		guard.unlock();
+		for (int c = 0; c < numCameras; c++)
+		{
+			if (!frames[c].empty() && (!lens[c].Built() || lens[c].imageSize != frames[c].size()))
+			{
+				lens[c].Build(cameras[c], frames[c].size());
+			}
+		}
+		bool changed = false, done = true;
+		for (int g = 0; g < triangulation.numGroups && g < NUM_CAMERAS / 2; g++)
+		{
+			if (estimate[g].views < WORLD_FRAME_VIEWS)
+			{
+				// every camera of the group that finds the board adds its view
+				ViewMask found = 0;
+				for (ViewMask rest = triangulation.groupViews[g]; rest; rest &= rest - 1)
+				{
+					const int c = CountTrailingZeros(rest);
+					if (Detect(frames[c], corners[c]))
+					{
+						found |= ViewMask(1) << c;
+					}
+				}
+				changed = (CountViews(found) >= 2 && AddView(g, corners, found)) || changed;
+			}
+			done = done && estimate[g].views >= WORLD_FRAME_VIEWS;
+		}
+		guard.lock();
+		for (int c = 0; c < numCameras; c++)
+		{
+			cv::swap(frames[c], pending[c]);
+		}
+		if (changed)
+		{
+			std::copy(estimate, estimate + NUM_CAMERAS / 2, published);
+			ready = true;
+		}
+		converged = done;
+		requested = false;
+	}
+}
+
+// This function finds the board on a downsampled grey image and refines each corner in a small window
+// of the full image, so neither the whole frame is converted nor refined. Corners are in image coordinates.
+bool WorldFrameWorker::Detect(const cv::Mat& image, std::vector<cv::Point2d>& corners) const
+{
+	if (image.empty())
+	{
+		return false;
+	}
+	cv::Mat small, grey;
+	cv::resize(image, small, cv::Size(image.cols / WORLD_FRAME_DOWNSAMPLE, image.rows / WORLD_FRAME_DOWNSAMPLE), 0, 0, cv::INTER_AREA);
+	cv::cvtColor(small, grey, CV_RGB2GRAY);
+	std::vector<cv::Point2f> found;
+	int flags = cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE | cv::CALIB_CB_FAST_CHECK;
+	if (!cv::findChessboardCorners(grey, cv::Size(WORLD_BOARD_COLUMNS, WORLD_BOARD_ROWS), found, flags))
+	{
+		return false;
+	}
+	const cv::Rect whole(0, 0, image.cols, image.rows);
+	const int side = 2 * WORLD_FRAME_WINDOW + 1;
+	corners.resize(found.size());
+	cv::Mat window;
+	std::vector<cv::Point2f> corner(1);
+	for (size_t k = 0; k < found.size(); k++)
+	{
+		// a pixel of the small image covers WORLD_FRAME_DOWNSAMPLE pixels of the full one
+		const cv::Point2f at = found[k] * float(WORLD_FRAME_DOWNSAMPLE) + cv::Point2f(0.5f, 0.5f) * float(WORLD_FRAME_DOWNSAMPLE - 1);
+		const cv::Rect roi(cvRound(at.x) - WORLD_FRAME_WINDOW, cvRound(at.y) - WORLD_FRAME_WINDOW, side, side);
+		if ((roi & whole) != roi)
+		{
+			return false;
+		}
+		cv::cvtColor(image(roi), window, CV_RGB2GRAY);
+		corner[0] = at - cv::Point2f(float(roi.x), float(roi.y));
+		cv::cornerSubPix(window, corner, cv::Size(WORLD_FRAME_WINDOW - 2, WORLD_FRAME_WINDOW - 2), cv::Size(-1, -1),
+			cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 0.01));
+		corners[k] = cv::Point2d(corner[0].x + roi.x, corner[0].y + roi.y);
+	}
+	return true;
+}
+
+// This function triangulates the spanning corners of one board view from the cameras of views, adds them to the
+// average and rebuilds the frame of the group from the averaged corners. corners[c] holds the corners camera c found.
+bool WorldFrameWorker::AddView(int group, const std::vector<cv::Point2d> corners[], ViewMask views)
+{
+	cv::Point2d sensor[NUM_CAMERAS];
+	double weight[NUM_CAMERAS];
+	std::fill(weight, weight + NUM_CAMERAS, 1.0);
+	cv::Point3d corner[3];
+	for (int k = 0; k < 3; k++)
+	{
+		for (ViewMask rest = views; rest; rest &= rest - 1)
+		{
+			const int c = CountTrailingZeros(rest);
+			sensor[c] = lens[c].Correct(corners[c][WORLD_BOARD_CORNERS[k]]);
+		}
+		ViewMask inliers;
+		double residual;
+		if (!triangulation.Solve(sensor, weight, views, corner[k], inliers, residual))
+		{
+			return false; // the views disagree, the corners were matched wrongly
+		}
+	}
+	WorldFrame& frame = estimate[group];
+	frame.views++;
+	Vec3 p[3];
+	for (int k = 0; k < 3; k++)
+	{
+		cornerSum[group][k] = cornerSum[group][k] + ToVec3(corner[k]);
+		p[k] = cornerSum[group][k] * (1.0 / frame.views);
+	}
+	// x is normal to the board, y runs along the first row, z completes the frame
+	const Vec3 y = p[1] - p[0];
+	const Vec3 x = Cross(p[2] - p[0], y);
+	const Vec3 z = Cross(x, y);
+	frame.rotation = Mat33(Normalized(x), Normalized(y), Normalized(z));
+	frame.transform = -p[0];
+	std::cout << "World frame of pair " << group << " from " << frame.views << " views:\n" << frame.rotation << "\n" << frame.transform << std::endl;
+	return true;
+}
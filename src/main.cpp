@@ -2,6 +2,11 @@
 #include "SpinGenApi/SpinnakerGenApi.h"
 #include "Acquisition.hpp"
 #include "DataProcess.h"
+#include "StereoPredictor.h"
+#include "Reacquisition.hpp"
+#include "Benchmark.hpp"
+#include "AutoInitializer.hpp"
+#include "RigProfile.hpp"
 #include "Tracker.hpp"
 #include <iostream>
 #include <sstream>
@@ -20,11 +25,87 @@ using namespace std;
 
 // Example entry point; please see Enumeration example for more in-depth 
 // comments on preparing and cleaning up the system.
-int main(int /*argc*/, char** /*argv*/)
+int main(int argc, char** argv)
 {   
     // initialize
     Tracker tracker;
+	AutoInitializer autoInitializer;
+	bool interactiveInit = false;
+	RigProfile rigProfile;
+	std::string profilePath = "RigProfile.yml";
+	bool authorExclusions = false;
+	std::string colourPath = "ColourClasses.yml";
+	std::string calibrationPath = "RigCalibration.yml";
+	std::string gaitPath = "GaitData.csv";
+	std::string storePath;
+	// --markers <file> replaces the default leg marker set, --bench times the tracker kernels and exits,
+	// --interactive-init lets the user select the markers when automatic initialization fails,
+	// --profile <file> reads the static exclusions of the rig from another file than RigProfile.yml,
+	// --author-exclusions draws new exclusions on the first frames and saves them to the profile,
+	// --colours <file> reads the marker colour classes from another file than ColourClasses.yml,
+	// --calibration <file> reads the camera models written by the Calibrate tool from another file than RigCalibration.yml,
+	// or from a MAT file exported from MATLAB (see RigCalibration.h),
+	// --gait <file> writes the marker positions and joint angles of every frame to another file than GaitData.csv,
+	// as C3D when the name ends in .c3d,
+	// --store <name> also keeps the frames as the session <name>.gaitcol of the column store, which GaitQuery reads
+	for (int k = 1; k < argc; k++)
+	{
+		std::string option(argv[k]);
+		if (option == "--bench")
+		{
+			return RunBenchmarks();
+		}
+		if (option == "--interactive-init")
+		{
+			interactiveInit = true;
+		}
+		if (option == "--markers" && k + 1 < argc && !Tracker::LoadMarkerSet(argv[++k]))
+		{
+			std::cout << "Using the default marker set" << endl;
+		}
+		if (option == "--profile" && k + 1 < argc)
+		{
+			profilePath = argv[++k];
+		}
+		if (option == "--author-exclusions")
+		{
+			authorExclusions = true;
+		}
+		if (option == "--colours" && k + 1 < argc)
+		{
+			colourPath = argv[++k];
+		}
+		if (option == "--calibration" && k + 1 < argc)
+		{
+			calibrationPath = argv[++k];
+		}
+		if (option == "--gait" && k + 1 < argc)
+		{
+			gaitPath = argv[++k];
+		}
+		if (option == "--store" && k + 1 < argc)
+		{
+			storePath = argv[++k];
+		}
+	}
+	Tracker::colourClasses.Load(colourPath);
+	if (!authorExclusions && rigProfile.Load(profilePath))
+	{
+		rigProfile.BuildMasks(Tracker::allowedMask);
+	}
 	DataProcess dataProcess;
+	if (!dataProcess.LoadCalibration(calibrationPath))
+	{
+		std::cout << "Using the default camera models" << endl;
+	}
+	dataProcess.exporter.Open(gaitPath, Tracker::markerSet.names);
+	if (!storePath.empty())
+	{
+		dataProcess.archive.Open(storePath + ".gaitcol", Tracker::markerSet.names);
+	}
+	StereoPredictor stereoPredictor;
+	ReacquisitionWorker reacquisition;
+	WorldFrameWorker worldFrameWorker(dataProcess.cameras, NUM_CAMERAS);
 	bool status = true;
     // let the program know which camera to acquire image from
     
@@ -33,6 +114,10 @@ int main(int /*argc*/, char** /*argv*/)
     cv::namedWindow("Right_Upper",0);
     cv::namedWindow("Right_Lower", 0);
     cv::namedWindow("Left_Lower", 0);
+	// the window of each tracker camera, the overlays are drawn on copies so colours are sampled from clean frames
+	const char* windowNames[NUM_CAMERAS] = { "Left_Upper", "Left_Lower", "Right_Upper", "Right_Lower" };
+	static int windowCamera[NUM_CAMERAS] = { 0, 1, 2, 3 };
+	cv::Mat shown[NUM_CAMERAS];
     // Retrieve singleton reference to system object
     SystemPtr system = System::GetInstance();
     // Print Spinnaker library version
@@ -137,28 +222,45 @@ int main(int /*argc*/, char** /*argv*/)
 		// Create an array of CameraPtrs. This array maintenances smart pointer's reference
 		// count when CameraPtr is passed into grab thread as void pointer
 		AcquisitionParameters* paraList = new AcquisitionParameters[numCameras];
-		TrackerParameters* trackerParaList = new TrackerParameters[NUM_MARKERS];
-		Tracker* trackerList = new Tracker[NUM_MARKERS];
-		for (int j = 0; j < NUM_MARKERS; j++)
+		// ByColor follows markers by mean shift and detects blobs only when that fails,
+		// ByDetection always detects, ByBlobScan scans whole images instead of the detect windows
+		const TrackerType trackingMode = ByColor;
+		const int numMarkers = Tracker::numMarkers;
+		TrackerParameters* trackerParaList = new TrackerParameters[numMarkers];
+		Tracker* trackerList = new Tracker[numMarkers];
+		for (int j = 0; j < numMarkers; j++)
 		{
 			trackerParaList[j].trackerPtr = &trackerList[j];
 			trackerParaList[j].marker_index = j;
-			trackerParaList[j].tracker_type = ByDetection;
+			trackerParaList[j].tracker_type = trackingMode;
+		}
+		SegmentationParameters* segmentationParaList = new SegmentationParameters[NUM_CAMERAS];
+		for (int i = 0; i < NUM_CAMERAS; i++)
+		{
+			segmentationParaList[i].trackerPtr = &tracker;
+			segmentationParaList[i].camera_index = i;
 		}
 #if defined(_WIN32)
 		HANDLE* grabThreads = new HANDLE[numCameras];
-		HANDLE* trackerThreads = new HANDLE[NUM_MARKERS];
+		HANDLE* trackerThreads = new HANDLE[numMarkers];
+		HANDLE* segmentationThreads = new HANDLE[NUM_CAMERAS];
 #else
 		pthread_t* grabThreads = new pthread_t[numCameras];
-		pthread_t* trackerThreads = new pthread_t[NUM_MARKERS];
+		pthread_t* trackerThreads = new pthread_t[numMarkers];
+		pthread_t* segmentationThreads = new pthread_t[NUM_CAMERAS];
 #endif
 
 		
         // acquire images and do something
         // main part of this program
-        cv::setMouseCallback("Left_Upper", tracker.Mouse_getColor, 0);
+		// colours can be sampled in the window of every camera
+		for (int i = 0; i < NUM_CAMERAS; i++)
+		{
+			cv::setMouseCallback(windowNames[i], tracker.Mouse_getColor, &windowCamera[i]);
+		}
 		bool first_time = true;
 		int num_Acquisition = 0; // init tracker after some images to assure auto balance finished
+		auto sessionStart = std::chrono::high_resolution_clock::now(); // gait data is timed from here
         while(status)
         {
             // acquire images
@@ -225,55 +327,90 @@ int main(int /*argc*/, char** /*argv*/)
 			
             // pCam = NULL;
 			auto start_processing = std::chrono::high_resolution_clock::now();
+			// one stripe of each camera's background model, the windows of the last frame and the blobs
+			// initialization is looking at protect standing markers
+			for (int i = 0; i < NUM_CAMERAS; i++)
+			{
+				tracker.UpdateBackground(i, autoInitializer.Candidates(i));
+			}
+			// the world frame is found on a copy of the frames in the background, take the latest estimate
+			if (num_Acquisition > 15)
+			{
+				worldFrameWorker.Update(tracker.ReceivedImages, dataProcess.worldFrame);
+			}
 			if (tracker.TrackerAutoIntialized)
 			{	
 				memcpy(tracker.previousPos, tracker.currentPos, sizeof(tracker.currentPos));
 
-				for (int j = 0; j < NUM_MARKERS; j++)
+				// predict all windows, then segment each camera once for all of its markers,
+				// or scan each whole image once and pick the markers' blobs from it
+				tracker.PredictSearchWindows();
+				for (int i = 0; i < NUM_CAMERAS; i++)
 				{
-					// Start grab thread
-				/*cout << "processing" << i << endl;*/
-					trackerThreads[j] = CreateThread(nullptr, 0, UpdateTracker, &trackerParaList[j], 0, nullptr);
-					assert(trackerThreads[j] != nullptr);
+					segmentationThreads[i] = CreateThread(nullptr, 0, trackingMode == ByBlobScan ? UpdateBlobScan : UpdateSegmentation, &segmentationParaList[i], 0, nullptr);
+					assert(segmentationThreads[i] != nullptr);
 				}
-				// Wait for all threads to finish
-				WaitForMultipleObjects(NUM_MARKERS,		// number of threads to wait for 
-					trackerThreads,				// handles for threads to wait for
-					TRUE,					// wait for all of the threads
-					INFINITE				// wait forever
-				);
-				// Check thread return code for each camera
-				for (int j = 0; j < NUM_MARKERS; j++)
+				WaitForMultipleObjects(NUM_CAMERAS, segmentationThreads, TRUE, INFINITE);
+				for (int i = 0; i < NUM_CAMERAS; i++)
 				{
-					DWORD exitcode;
+					CloseHandle(segmentationThreads[i]);
+				}
 
-					BOOL rc = GetExitCodeThread(trackerThreads[j], &exitcode);
-					if (!rc)
+				if (trackingMode != ByBlobScan)
+				{
+					for (int j = 0; j < numMarkers; j++)
 					{
-						cout << "Handle error from GetExitCodeThread() returned for camera at index " << j << endl;
+						// Start grab thread
+					/*cout << "processing" << i << endl;*/
+						trackerThreads[j] = CreateThread(nullptr, 0, UpdateTracker, &trackerParaList[j], 0, nullptr);
+						assert(trackerThreads[j] != nullptr);
 					}
-					else if (!exitcode)
+					// Wait for all threads to finish
+					WaitForMultipleObjects(numMarkers,		// number of threads to wait for 
+						trackerThreads,				// handles for threads to wait for
+						TRUE,					// wait for all of the threads
+						INFINITE				// wait forever
+					);
+					// Check thread return code for each camera
+					for (int j = 0; j < numMarkers; j++)
 					{
-						cout << "Grab thread for camera at index " << j << " exited with errors."
-							"Please check onscreen print outs for error details" << endl;
-					}					
+						DWORD exitcode;
+
+						BOOL rc = GetExitCodeThread(trackerThreads[j], &exitcode);
+						if (!rc)
+						{
+							cout << "Handle error from GetExitCodeThread() returned for camera at index " << j << endl;
+						}
+						else if (!exitcode)
+						{
+							cout << "Grab thread for camera at index " << j << " exited with errors."
+								"Please check onscreen print outs for error details" << endl;
+						}					
+					}
+					// give the blobs found in the windows to the markers with the least total distance to their predictions
+					for (int i = 0; i < NUM_CAMERAS; i++)
+					{
+						tracker.AssignMarkers(i);
+					}
 				}
+				// take back markers found by the full frame search and hand over cameras that lost markers
+				reacquisition.Update(tracker);
 				for (int i = 0; i < numCameras; i++)
 				{
-					tracker.RectifyMarkerPos(i);
-					for (int marker_index = 0; marker_index < NUM_MARKERS; marker_index++)
+					for (int marker_index = 0; marker_index < numMarkers; marker_index++)
 					{
 						std::cout << i << marker_index << tracker.currentPos[i][marker_index] << std::endl;
-						cv::circle(tracker.ReceivedImages[i], tracker.currentPos[i][marker_index], 3, cv::Scalar(0, 0, 255),3);
-						cv::rectangle(tracker.ReceivedImages[i], cv::Rect(tracker.currentPos[i][marker_index].x - tracker.detectWindowDimX / 2,
-							tracker.currentPos[i][marker_index].y - tracker.detectWindowDimY / 2, tracker.detectWindowDimX, tracker.detectWindowDimY), cv::Scalar(255, 0, 0));
 					}
 				}
 				auto track_processing = std::chrono::high_resolution_clock::now();
 				std::chrono::duration<double> elapsed_seconds_processing = track_processing - start_processing;
 				std::cout << "Time on tracking " << ": " << elapsed_seconds_processing.count() << std::endl;
 				memcpy(dataProcess.points, tracker.currentPos, sizeof(tracker.currentPos));
-				dataProcess.exportGaitData();
+				std::chrono::duration<double> frameTime = start - sessionStart;
+				dataProcess.exportGaitData(frameTime.count());
+				// place next frame's windows from the 3D trajectory of each marker
+				stereoPredictor.Update(dataProcess);
+				stereoPredictor.GuideTracker(dataProcess);
 				auto stop_export = std::chrono::high_resolution_clock::now();
 				std::chrono::duration<double> seconds_export = stop_export - track_processing;
 				std::cout << "Time on export gait data: " << seconds_export.count() << std::endl;
@@ -281,42 +418,54 @@ int main(int /*argc*/, char** /*argv*/)
 			
 			if (/*tracker.getColors && */!tracker.TrackerAutoIntialized && dataProcess.GotWorldFrame)
 			{
-				tracker.InitTracker(ByDetection);
+				if (authorExclusions)
+				{
+					rigProfile.AuthorExclusions(tracker.ReceivedImages, numCameras);
+					rigProfile.Save(profilePath);
+					rigProfile.BuildMasks(Tracker::allowedMask);
+					authorExclusions = false;
+				}
+				if (autoInitializer.Step(tracker) == AutoInitializer::TimedOut)
+				{
+					if (interactiveInit)
+					{
+						tracker.InitTracker(ByDetection);
+					}
+					autoInitializer.Reset();
+				}
 				//getchar();
 			}
+			// tracking does not wait for the world frame, it converges in the background
 			if (!dataProcess.GotWorldFrame && num_Acquisition > 15)
 			{
 				dataProcess.GotWorldFrame = true;
-				/*try
+			}
+			
+			for (int i = 0; i < NUM_CAMERAS; i++)
+			{
+				// copyTo reuses the buffers of the last frame
+				tracker.ReceivedImages[i].copyTo(shown[i]);
+				for (int marker_index = 0; tracker.TrackerAutoIntialized && i < int(numCameras) && marker_index < numMarkers; marker_index++)
 				{
-					bool found = dataProcess.FindWorldFrame(tracker.ReceivedImages[0], tracker.ReceivedImages[1]);
-					found = dataProcess.FindWorldFrame(tracker.ReceivedImages[2], tracker.ReceivedImages[3]) && found;
-					if (found)
-					{
-						dataProcess.GotWorldFrame = true;
-						cout << "Find world coordinate system succeed!" << endl;
-					}
-					else
-					{
-						dataProcess.GotWorldFrame = false;
-						cout << "Find world coordinate system failed!\a\a\a" << endl;
-					}
+					cv::circle(shown[i], tracker.currentPos[i][marker_index], 3, cv::Scalar(0, 0, 255), 3);
+					cv::rectangle(shown[i], tracker.searchWindow[i][marker_index], cv::Scalar(255, 0, 0));
 				}
-				catch (cv::Exception& e)
-				{
-					std::cout << "OpenCV Error: during finding world frame: \n" << e.what() << endl;
-				}*/
+				cv::imshow(windowNames[i], shown[i]);
 			}
-			
-			cv::imshow("Left_Upper", tracker.ReceivedImages[0]);
-			cv::imshow("Left_Lower", tracker.ReceivedImages[1]);
-			cv::imshow("Right_Upper", tracker.ReceivedImages[2]);
-			cv::imshow("Right_Lower", tracker.ReceivedImages[3]);
 			int key = cv::waitKey(1);
 			if (key == 27)
 			{
 				status = false;
 			}
+			// a colour was sampled in a camera window, once every marker has its samples the classes take over identity
+			if (tracker.getColors)
+			{
+				tracker.getColors = false;
+				if (Tracker::colourClasses.Sampled(numMarkers) && Tracker::colourClasses.Compile())
+				{
+					Tracker::colourClasses.Save(colourPath);
+				}
+			}
 			num_Acquisition += 1;
         }
 		// Clear CameraPtr array and close all handles
@@ -324,7 +473,7 @@ int main(int /*argc*/, char** /*argv*/)
 		{    
 			CloseHandle(grabThreads[i]);
 		}
-		for (int j = 0; j < NUM_MARKERS; j++)
+		for (int j = 0; j < numMarkers && trackingMode != ByBlobScan; j++)
 		{
 			CloseHandle(trackerThreads[j]);
 		}
@@ -332,9 +481,13 @@ int main(int /*argc*/, char** /*argv*/)
 		// Delete array pointer
 		delete[] paraList;
 		delete[] trackerParaList;
+		delete[] segmentationParaList;
 		delete[] trackerThreads;
+		delete[] segmentationThreads;
 		delete[] grabThreads;
         cv::destroyAllWindows();
+		dataProcess.exporter.Close();
+		dataProcess.archive.Close();
 		pCam = NULL;
     }
     // sometimes AcquireImages may throw cv::Exception or Spinnaker::Exception